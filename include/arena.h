@@ -0,0 +1,141 @@
+/* arena.h - A simple arena (region) memory allocator.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#include "brlib.h"
+#include "list.h"
+
+#define ARENA_NAME_LENGTH (16)                    /* max name length including trailing \0 */
+
+typedef struct {
+    struct list_head list_blocks;                 /* list of allocated blocks in arena */
+    char *end;                                    /* end of block data */
+    char data[];                                  /* objects block */
+} arena_block_t;
+
+typedef struct {
+    char name[ARENA_NAME_LENGTH];                 /* arena name */
+    size_t blocksize;                             /* default block data size */
+    u32 nblocks;                                  /* number of blocks allocated */
+    size_t used;                                  /* bytes used in previous blocks */
+    char *cur;                                    /* next free byte in current block */
+    arena_block_t *block;                         /* current block, or NULL */
+    struct list_head list_blocks;                 /* allocated blocks, current is last */
+} arena_t;
+
+/* arena checkpoint, see arena_mark() and arena_rewind()
+ */
+typedef struct {
+    arena_block_t *block;                         /* current block at mark time */
+    char *cur;                                    /* next free byte at mark time */
+    size_t used;                                  /* bytes used in previous blocks */
+} arena_mark_t;
+
+/**
+ * arena_stats - display some arena statistics
+ * @arena:   the arena address.
+ */
+void arena_stats(arena_t *arena);
+
+/**
+ * arena_create - create a new arena
+ * @name:    the name to give to the arena.
+ * @size:    the default size of arena blocks.
+ *
+ * The name will be truncated to 16 characters (including the final '\0').
+ * Blocks are allocated on demand: a new block of @size bytes (or more, for
+ * larger requests) is added when the current one is full.
+ *
+ * Return:   The address of the created arena, or NULL if error (errno is set
+ *           to ENOMEM).
+ */
+arena_t *arena_create(const char *name, size_t size);
+
+/**
+ * arena_alloc - allocate memory from an arena
+ * @arena:   the arena address.
+ * @size:    the size to allocate.
+ *
+ * Memory is aligned for any type (alignof(max_align_t)). It is released only
+ * by arena_rewind(), arena_reset() or arena_destroy(): there is no way to free
+ * a single allocation.
+ *
+ * Return:   The allocated memory address, or NULL if error (errno is set to
+ *           ENOMEM).
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/**
+ * arena_alloc_align - allocate aligned memory from an arena
+ * @arena:   the arena address.
+ * @size:    the size to allocate.
+ * @align:   the alignment, a power of two.
+ *
+ * Same as arena_alloc(), with an explicit alignment.
+ *
+ * Return:   The allocated memory address, or NULL if error (errno is set to
+ *           ENOMEM).
+ */
+void *arena_alloc_align(arena_t *arena, size_t size, size_t align);
+
+/**
+ * arena_mark - get a checkpoint of an arena
+ * @arena:   the arena address.
+ *
+ * Return:   A checkpoint to be used by arena_rewind().
+ */
+arena_mark_t arena_mark(arena_t *arena);
+
+/**
+ * arena_rewind - release all memory allocated after a checkpoint
+ * @arena:   the arena address.
+ * @mark:    a checkpoint returned by arena_mark().
+ *
+ * All allocations made after @mark was taken are released at once. Blocks
+ * added after @mark are freed. @mark, and all checkpoints taken after it,
+ * become invalid if an older checkpoint is rewound.
+ */
+void arena_rewind(arena_t *arena, arena_mark_t mark);
+
+/**
+ * arena_reset - release all memory allocated from an arena
+ * @arena:   the arena address.
+ *
+ * All allocations are released at once, in O(blocks). The first block is kept
+ * for future allocations, other ones are freed.
+ */
+void arena_reset(arena_t *arena);
+
+/**
+ * arena_used - get arena used memory
+ * @arena:   the arena address.
+ *
+ * Return:   The number of bytes allocated from @arena, including alignment
+ *           padding.
+ */
+size_t arena_used(arena_t *arena);
+
+/**
+ * arena_destroy - destroy an arena.
+ * @arena:   the arena address.
+ *
+ * Attention: All memory is freed. Referencing any memory allocated from @arena
+ * after this call will likely imply some memory corruption.
+ */
+void arena_destroy(arena_t *arena);
+
+#endif
@@ -226,13 +226,14 @@ void print_bitops_impl(void);
 #define ror64(num, n) ((num >> (n & 63)) | (num << ((-n) & 63)))
 
 /**
- * ilog2_32, ilog2_64 - log base 2
- * @n: unsigned 32 or 64 bits integer.
+ * ilog2_32, ilog2_64, ilog2 - log base 2
+ * @n: unsigned 32 or 64 bits integer, any unsigned integer for ilog2.
  *
  * Undefine value if n = 0.
  */
 #define ilog2_32(n) (msb32(n))
 #define ilog2_64(n) (msb64(n))
+#define ilog2(n)    (sizeof(n) <= 4? ilog2_32(n): ilog2_64(n))
 
 /**
  * is_pow2() - check if number is a power of two
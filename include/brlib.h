@@ -91,6 +91,10 @@ typedef signed char schar;
 #define __used               __attribute__((__used__))
 #define __const              __attribute__((__const__))
 
+/* variables/types alignment
+ */
+#define __aligned(x)         __attribute__((__aligned__(x)))
+
 /* see https://lkml.org/lkml/2018/3/20/845 for explanation of this monster
  */
 #define __is_constexpr(x) \
@@ -244,6 +248,13 @@ typedef signed char schar;
  */
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 
+/**
+ * ALIGN - round up a value to a power of two
+ * @x: the value
+ * @a: the alignment, a power of two
+ */
+#define ALIGN(x, a)	(((x) + ((typeof(x))(a) - 1)) & ~((typeof(x))(a) - 1))
+
 /**
  * abs - return absolute value of an argument
  * @x: the value.  If it is unsigned type, it is converted to signed type first.
@@ -0,0 +1,99 @@
+/* brmalloc.h - A small objects allocator, based on pools.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#ifndef _BRMALLOC_H
+#define _BRMALLOC_H
+
+#include <stddef.h>
+
+#include "brlib.h"
+#include "bitops.h"
+
+#define BRMALLOC_MAX_SIZE   (4096)                /* largest size class */
+#define BRMALLOC_NCLASSES   (32)                  /* number of size classes */
+#define BRMALLOC_BLOCK_SIZE (1UL << 18)           /* pools blocks size */
+
+/**
+ * brmalloc_class - get size class index of a size.
+ * @size:    the requested size (1 to BRMALLOC_MAX_SIZE).
+ *
+ * Size classes are:
+ * - 8 to 64 bytes, by steps of 8 bytes (classes 0-7).
+ * - 4 classes between two powers of two, from 64 to 4096 bytes: 80, 96, 112,
+ *   128, 160, 192, ..., 3584, 4096 (classes 8-31).
+ *
+ * Return:   The size class index.
+ */
+static inline uint brmalloc_class(size_t size)
+{
+    uint l, shift;
+
+    if (size <= 64)
+        return size? (size - 1) >> 3: 0;
+    l = fls32(size - 1);                          /* 64 < size <= 1 << l */
+    shift = l - 3;
+    return 8 + (l - 7) * 4 + (((size - 1) >> shift) & 3);
+}
+
+/**
+ * brmalloc_class_size - get size class objects size.
+ * @class:   the size class index.
+ *
+ * Return:   The objects size in @class.
+ */
+static inline size_t brmalloc_class_size(uint class)
+{
+    if (class < 8)
+        return (class + 1) << 3;
+    class -= 8;
+    return (size_t) (5 + (class & 3)) << ((class >> 2) + 4);
+}
+
+/**
+ * br_malloc - allocate memory.
+ * @size:    the size to allocate.
+ *
+ * Requests up to BRMALLOC_MAX_SIZE bytes are served by one of the size classes
+ * pools, larger ones by malloc(3), with a 16 bytes header.
+ * Memory is 8-bytes aligned for sizes up to 64 bytes, and 16-bytes aligned for
+ * larger ones.
+ * br_malloc() and br_free() are thread-safe.
+ *
+ * Return:   The allocated memory address, or NULL if error.
+ */
+void *br_malloc(size_t size);
+
+/**
+ * br_free - release memory allocated by br_malloc().
+ * @ptr:     the memory address, or NULL.
+ *
+ * The object size class is found by masking @ptr address, after checking
+ * in a map that no large object starts in its block area.
+ */
+void br_free(void *ptr);
+
+/**
+ * br_usable_size - get usable size of a br_malloc() allocation.
+ * @ptr:     the memory address.
+ *
+ * Return:   The usable size: the size class size for small objects, or the
+ *           requested size for larger ones.
+ */
+size_t br_usable_size(void *ptr);
+
+/**
+ * br_malloc_stats - display size classes pools statistics.
+ */
+void br_malloc_stats(void);
+
+#endif  /* _BRMALLOC_H */
@@ -0,0 +1,140 @@
+/* cuckoo.h - bucketized cuckoo hashtables.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * A cuckoo hashtable mapping u64 keys to u64 values. Each key has two
+ * candidate buckets of CUCKOO_SLOTS slots, given by two hash functions:
+ *   - hash_64() (see hash.h).
+ *   - the same multiplicative hash, with another multiplier, on the key
+ *     with its 32 bits halves swapped.
+ * A key is always in one of its two buckets: lookups read at most two
+ * buckets (with 4 slots, a bucket is one cache line), whatever the keys.
+ *
+ * When both buckets are full, insertion moves ("kicks") a random entry of
+ * one bucket to its other bucket, and so on, up to CUCKOO_MAX_KICKS times.
+ * If it fails, the table is rebuilt with new hash seeds: same size if it
+ * was less than CUCKOO_MIN_LOAD% full (unlucky or adversarial keys), twice
+ * larger otherwise. As key seeds change at each rebuild, sets of keys built
+ * to collide in hash_64() do not survive a rebuild.
+ *
+ * The table does not shrink. Tables are not thread-safe.
+ */
+
+#ifndef _CUCKOO_H
+#define _CUCKOO_H
+
+#include "brlib.h"
+
+#ifndef CUCKOO_SLOTS
+#define CUCKOO_SLOTS      4                       /* slots per bucket: 4 or 8 */
+#endif
+#define CUCKOO_MIN_BITS   2                       /* log2(minimum buckets) */
+#define CUCKOO_MAX_KICKS  256                     /* moves before rebuild */
+#define CUCKOO_MIN_LOAD   50                      /* rebuild same size below */
+#define CUCKOO_EMPTY      (~0ULL)                 /* empty slot key */
+
+struct cuckoo_bucket {
+    u64 keys[CUCKOO_SLOTS];
+    u64 vals[CUCKOO_SLOTS];
+} __aligned(64);
+
+typedef struct cuckoo {
+    struct cuckoo_bucket *buckets;
+    u32 bits;                                     /* log2(buckets) */
+    u64 seed;                                     /* keys seed */
+    u64 count;                                    /* keys in table */
+    u64 rand;                                     /* kick victims generator */
+    bool has_empty;                               /* CUCKOO_EMPTY is a key */
+    u64 empty_val;                                /* ... and its value */
+    /* statistics */
+    u64 kicks;                                    /* total moves */
+    u64 maxkicks;                                 /* max moves for an insertion */
+    u64 grows;                                    /* rebuilds with size doubling */
+    u64 reseeds;                                  /* same-size rebuilds */
+} cuckoo_t;
+
+/**
+ * cuckoo_create - create a cuckoo hashtable.
+ * @hint:    expected number of keys, or 0.
+ *
+ * Return:   The table, or NULL if error (errno is set to ENOMEM).
+ */
+cuckoo_t *cuckoo_create(u64 hint);
+
+/**
+ * cuckoo_get - find a key.
+ * @table:   the table.
+ * @key:     the key.
+ *
+ * Return:   The key value address, or NULL if not found. It is valid until
+ *           next insertion.
+ */
+u64 *cuckoo_get(cuckoo_t *table, u64 key);
+
+/**
+ * cuckoo_put - insert or replace a key.
+ * @table:   the table.
+ * @key:     the key.
+ * @val:     the value.
+ *
+ * Return:   0 on success, -1 on error (errno is set to ENOMEM).
+ */
+int cuckoo_put(cuckoo_t *table, u64 key, u64 val);
+
+/**
+ * cuckoo_del - delete a key.
+ * @table:   the table.
+ * @key:     the key.
+ *
+ * Return:   true if key was found and deleted.
+ */
+bool cuckoo_del(cuckoo_t *table, u64 key);
+
+/**
+ * cuckoo_next - iterate over a table.
+ * @table:   the table.
+ * @pos:     u64 iteration cursor, to be initialized to 0.
+ * @key:     address of key to set, or NULL.
+ *
+ * Return:   The next key value address, or NULL at table end.
+ */
+u64 *cuckoo_next(cuckoo_t *table, u64 *pos, u64 *key);
+
+/**
+ * cuckoo_count - number of keys in table.
+ * @table:   the table.
+ */
+static inline u64 cuckoo_count(const cuckoo_t *table)
+{
+    return table->count;
+}
+
+/**
+ * cuckoo_capacity - number of slots in table.
+ * @table:   the table.
+ */
+static inline u64 cuckoo_capacity(const cuckoo_t *table)
+{
+    return (u64) CUCKOO_SLOTS << table->bits;
+}
+
+/**
+ * cuckoo_stats - log table statistics.
+ * @table:   the table.
+ */
+void cuckoo_stats(cuckoo_t *table);
+
+/**
+ * cuckoo_destroy - destroy a table.
+ * @table:   the table.
+ */
+void cuckoo_destroy(cuckoo_t *table);
+
+#endif  /* _CUCKOO_H */
@@ -0,0 +1,172 @@
+/* hashstats.h - hashtables chain-length diagnostics.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#ifndef _HASHSTATS_H
+#define _HASHSTATS_H
+
+#include "brlib.h"
+#include "list.h"
+#include "list_bl.h"
+
+/* Chain-length diagnostics: tell how well a hash function distributes the
+ * actual keys over a table buckets.
+ * Tables are walked once, without allocation, with RCU-safe loads: this is
+ * O(buckets + entries), and may be done periodically on live tables, under
+ * the same protection as lookups (bucket locks or rcu_read_lock()).
+ * Other tables (htable, shtable...) can feed hash_stats_chain() directly.
+ */
+#define HASH_STATS_HIST 16                        /* last slot is ">= 15" */
+
+typedef struct hash_stats {
+    u64 buckets;                                  /* number of buckets */
+    u64 used;                                     /* non-empty buckets */
+    u64 entries;                                  /* total entries */
+    u64 maxchain;                                 /* longest chain */
+    u64 sumsq;                                    /* sum of chain length^2 */
+    u64 hist[HASH_STATS_HIST];                    /* chain length histogram */
+} hash_stats_t;
+
+/**
+ * hash_stats_init - reset hashtable statistics.
+ * @stats: the statistics to reset.
+ */
+static inline void hash_stats_init(hash_stats_t *stats)
+{
+    *stats = (hash_stats_t) { 0 };
+}
+
+/**
+ * hash_stats_chain - account one bucket.
+ * @stats: the statistics to update.
+ * @len:   bucket chain length.
+ */
+static inline void hash_stats_chain(hash_stats_t *stats, u64 len)
+{
+    stats->buckets++;
+    stats->entries += len;
+    stats->sumsq += len * len;
+    stats->used += !!len;
+    stats->hist[min(len, (u64) HASH_STATS_HIST - 1)]++;
+    if (len > stats->maxchain)
+        stats->maxchain = len;
+}
+
+/**
+ * hash_stats_hlist - account an hlist hashtable.
+ * @stats: the statistics to update (not reset).
+ * @ht:    the buckets array.
+ * @sz:    number of buckets.
+ *
+ * See hash_stats() below for DEFINE_HASHTABLE() tables.
+ */
+void hash_stats_hlist(hash_stats_t *stats, struct hlist_head *ht, u64 sz);
+
+/**
+ * hash_stats_hlist_bl - account a bit-locked hlist hashtable.
+ * @stats: the statistics to update (not reset).
+ * @ht:    the buckets array.
+ * @sz:    number of buckets.
+ *
+ * Buckets are not locked. See hash_stats_bl() below for
+ * DEFINE_HASHTABLE_BL() tables.
+ */
+void hash_stats_hlist_bl(hash_stats_t *stats, struct hlist_bl_head *ht, u64 sz);
+
+/**
+ * hash_stats - account a hashtable.h table.
+ * @hashtable: the hashtable.
+ * @stats:     the statistics to update (not reset).
+ *
+ * Must be called under the same protection as lookups.
+ */
+#define hash_stats(hashtable, stats)                                    \
+    hash_stats_hlist(stats, hashtable, HASH_SIZE(hashtable))
+
+/**
+ * hash_stats_bl - account a hashtable_bl.h table.
+ * @hashtable: the hashtable.
+ * @stats:     the statistics to update (not reset).
+ *
+ * Buckets are not locked: the caller must be in a RCU read-side critical
+ * section if the table may change.
+ */
+#define hash_stats_bl(hashtable, stats)                                 \
+    hash_stats_hlist_bl(stats, hashtable, HASH_SIZE(hashtable))
+
+/**
+ * hash_stats_mean - mean chain length of non-empty buckets.
+ * @stats: the statistics.
+ */
+static inline double hash_stats_mean(const hash_stats_t *stats)
+{
+    return stats->used? (double) stats->entries / stats->used: 0.0;
+}
+
+/**
+ * hash_stats_empty - empty buckets ratio.
+ * @stats: the statistics.
+ */
+static inline double hash_stats_empty(const hash_stats_t *stats)
+{
+    return stats->buckets?
+        (double) (stats->buckets - stats->used) / stats->buckets: 0.0;
+}
+
+/**
+ * hash_stats_hit_cost - expected entries compared by a successful lookup.
+ * @stats: the statistics.
+ *
+ * The i-th entry of a chain costs i comparisons, that is a chain of length
+ * L costs L * (L + 1) / 2 for its L entries.
+ */
+static inline double hash_stats_hit_cost(const hash_stats_t *stats)
+{
+    return stats->entries?
+        (double) (stats->sumsq + stats->entries) / (2 * stats->entries): 0.0;
+}
+
+/**
+ * hash_stats_miss_cost - expected entries compared by an unsuccessful lookup.
+ * @stats: the statistics.
+ *
+ * Return: the load factor, as a missing key walks a whole (random) chain.
+ */
+static inline double hash_stats_miss_cost(const hash_stats_t *stats)
+{
+    return stats->buckets? (double) stats->entries / stats->buckets: 0.0;
+}
+
+/**
+ * hash_stats_ideal_cost - successful lookup cost with an ideal hash function.
+ * @stats: the statistics.
+ *
+ * With uniform hashing of n keys over m buckets, this is 1 + (n - 1) / 2m.
+ * hash_stats_hit_cost() / hash_stats_ideal_cost() much above 1.0 means that
+ * the hash function does not fit the keys.
+ */
+static inline double hash_stats_ideal_cost(const hash_stats_t *stats)
+{
+    return stats->entries?
+        1.0 + (double) (stats->entries - 1) / (2 * stats->buckets): 0.0;
+}
+
+/**
+ * hash_stats_log - log hashtable statistics.
+ * @name:  table name, for output.
+ * @stats: the statistics.
+ *
+ * Summary is logged at debug level 1, histogram at level 2.
+ */
+void hash_stats_log(const char *name, const hash_stats_t *stats);
+
+#endif  /* _HASHSTATS_H */
@@ -15,6 +15,11 @@
 #include "hash.h"
 //#include <linux/rculist.h>
 
+/*
+ * The _rcu variants below need rculist.h. Bit-locked and tagged hashtables
+ * are in hashtable_bl.h and hashtable_tag.h, statistics in hashstats.h.
+ */
+
 #define DEFINE_HASHTABLE(name, bits)						\
 	struct hlist_head name[1 << (bits)] =					\
 			{ [0 ... ((1 << (bits)) - 1)] = HLIST_HEAD_INIT }
@@ -109,6 +114,12 @@ static inline void hash_del(struct hlist_node *node)
 	hlist_del_init(node);
 }
 
+/**
+ * hash_del_rcu - remove an object from a rcu enabled hashtable
+ * @node: &struct hlist_node of the object to remove
+ */
+#define hash_del_rcu(node) hlist_del_init_rcu(node)
+
 /**
  * hash_for_each - iterate over a hashtable
  * @name: hashtable to iterate
@@ -198,5 +209,62 @@ static inline void hash_del(struct hlist_node *node)
 	hlist_for_each_entry_safe(obj, tmp,\
 		&name[hash_min(key, HASH_BITS(name))], member)
 
+/*
+ * Batched lookups: a loop of hash_for_each_possible() lookups on a large
+ * table stalls twice per key, on the bucket head, then on the first object.
+ * hash_lookup_batch() processes keys by groups of HASH_BATCH: it computes
+ * all buckets and prefetches them, then prefetches all first objects, and
+ * only then walks the chains, so that memory accesses of a group overlap.
+ * HASH_BATCH may be defined before including this file.
+ */
+#ifndef HASH_BATCH
+#define HASH_BATCH 16
+#endif
+
+/**
+ * hash_lookup_batch - look up an array of keys in a hashtable
+ * @name: hashtable to search
+ * @keys: array of keys, of the type used with hash_add()
+ * @n: number of keys
+ * @res: array of @n type * to store results (NULL if key not found)
+ * @member: the name of the hlist_node within the struct
+ * @field: the name of the key within the struct
+ *
+ * The first object whose @field equals the key is returned.
+ */
+#define hash_lookup_batch(name, keys, n, res, member, field) do {		\
+	struct hlist_head *__head[HASH_BATCH];					\
+	struct hlist_node *__first[HASH_BATCH];					\
+	size_t __n = (n);							\
+										\
+	for (size_t __b = 0; __b < __n; __b += HASH_BATCH) {			\
+		size_t __m = min_t(size_t, __n - __b, HASH_BATCH);		\
+										\
+		for (size_t __i = 0; __i < __m; __i++) {			\
+			__head[__i] = &name[hash_min((keys)[__b + __i],		\
+						     HASH_BITS(name))];		\
+			prefetch(__head[__i]);					\
+		}								\
+		for (size_t __i = 0; __i < __m; __i++) {			\
+			__first[__i] = __head[__i]->first;			\
+			prefetch(__first[__i]);					\
+		}								\
+		for (size_t __i = 0; __i < __m; __i++) {			\
+			__typeof__(*(res)) __obj;				\
+										\
+			(res)[__b + __i] = NULL;				\
+			for (__obj = hlist_entry_safe(__first[__i],		\
+					__typeof__(*__obj), member);		\
+			     __obj;						\
+			     __obj = hlist_entry_safe(__obj->member.next,	\
+					__typeof__(*__obj), member)) {		\
+				if (__obj->field == (keys)[__b + __i]) {	\
+					(res)[__b + __i] = __obj;		\
+					break;					\
+				}						\
+			}							\
+		}								\
+	}									\
+} while (0)
 
 #endif
@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* hashtable_bl.h - bit-locked hashtables, after <linux/hashtable.h>.
+ */
+
+#ifndef _HASHTABLE_BL_H
+#define _HASHTABLE_BL_H
+
+#include "hashtable.h"
+#include "list_bl.h"
+#include "rculist_bl.h"
+
+/*
+ * Bit-locked hashtables: buckets are hlist_bl lists, whose head lowest bit
+ * is a per-bucket spinlock (see list_bl.h). Concurrent writers only contend
+ * on the same bucket, at no memory cost.
+ * Writers lock the bucket (hash_bl_head() and hlist_bl_lock()), or use
+ * hash_add_bl() and hash_del_bl() which do it. Readers either lock the
+ * bucket and use hash_for_each_possible_bl(), or use
+ * hash_for_each_possible_bl_rcu() within rcu_read_lock(); in the latter
+ * case, removed objects must be freed after a grace period (see rcu.h).
+ */
+#define DEFINE_HASHTABLE_BL(name, bits)						\
+	struct hlist_bl_head name[1 << (bits)] =				\
+			{ [0 ... ((1 << (bits)) - 1)] = HLIST_BL_HEAD_INIT }
+
+#define DECLARE_HASHTABLE_BL(name, bits)					\
+	struct hlist_bl_head name[1 << (bits)]
+
+static inline void __hash_init_bl(struct hlist_bl_head *ht, unsigned int sz)
+{
+	unsigned int i;
+
+	for (i = 0; i < sz; i++)
+		INIT_HLIST_BL_HEAD(&ht[i]);
+}
+
+/**
+ * hash_init_bl - initialize a bit-locked hash table
+ * @hashtable: hashtable to be initialized
+ */
+#define hash_init_bl(hashtable) __hash_init_bl(hashtable, HASH_SIZE(hashtable))
+
+/**
+ * hash_bl_head - get the bucket of a key in a bit-locked hashtable
+ * @hashtable: hashtable
+ * @key: the key
+ */
+#define hash_bl_head(hashtable, key)						\
+	(&(hashtable)[hash_min(key, HASH_BITS(hashtable))])
+
+/**
+ * hash_add_bl - add an object to a bit-locked hashtable
+ * @hashtable: hashtable to add to
+ * @node: the &struct hlist_bl_node of the object to be added
+ * @key: the key of the object to be added
+ *
+ * The bucket is locked during insertion. RCU readers may run concurrently.
+ */
+#define hash_add_bl(hashtable, node, key) do {					\
+	struct hlist_bl_head *__b = hash_bl_head(hashtable, key);		\
+	hlist_bl_lock(__b);							\
+	hlist_bl_add_head_rcu(node, __b);					\
+	hlist_bl_unlock(__b);							\
+} while (0)
+
+/**
+ * hash_del_bl - remove an object from a bit-locked hashtable
+ * @hashtable: hashtable to remove from
+ * @node: the &struct hlist_bl_node of the object to remove
+ * @key: the key of the object to remove
+ *
+ * The bucket is locked during removal. RCU readers may run concurrently.
+ */
+#define hash_del_bl(hashtable, node, key) do {					\
+	struct hlist_bl_head *__b = hash_bl_head(hashtable, key);		\
+	hlist_bl_lock(__b);							\
+	hlist_bl_del_rcu(node);							\
+	hlist_bl_unlock(__b);							\
+} while (0)
+
+/**
+ * hash_for_each_bl - iterate over a bit-locked hashtable
+ * @name: hashtable to iterate
+ * @bkt: integer to use as bucket loop cursor
+ * @obj: the type * to use as a loop cursor for each entry
+ * @pos: the &struct hlist_bl_node to use as a loop cursor
+ * @member: the name of the hlist_bl_node within the struct
+ *
+ * Buckets are not locked.
+ */
+#define hash_for_each_bl(name, bkt, obj, pos, member)				\
+	for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < HASH_SIZE(name);\
+			(bkt)++)						\
+		for (pos = hlist_bl_first(&name[bkt]);				\
+		     (obj = pos ? hlist_bl_entry(pos, __typeof__(*obj), member)\
+				: NULL);					\
+		     pos = pos->next)
+
+/**
+ * hash_for_each_possible_bl - iterate over all possible objects hashing to the
+ * same bucket in a bit-locked hashtable
+ * @name: hashtable to iterate
+ * @obj: the type * to use as a loop cursor for each entry
+ * @pos: the &struct hlist_bl_node to use as a loop cursor
+ * @member: the name of the hlist_bl_node within the struct
+ * @key: the key of the objects to iterate over
+ *
+ * The caller must hold the bucket lock.
+ */
+#define hash_for_each_possible_bl(name, obj, pos, member, key)			\
+	hlist_bl_for_each_entry(obj, pos, hash_bl_head(name, key), member)
+
+/**
+ * hash_for_each_possible_bl_rcu - iterate over all possible objects hashing to
+ * the same bucket in a bit-locked hashtable, without locking
+ * @name: hashtable to iterate
+ * @obj: the type * to use as a loop cursor for each entry
+ * @pos: the &struct hlist_bl_node to use as a loop cursor
+ * @member: the name of the hlist_bl_node within the struct
+ * @key: the key of the objects to iterate over
+ *
+ * The caller must be in a RCU read-side critical section.
+ */
+#define hash_for_each_possible_bl_rcu(name, obj, pos, member, key)		\
+	hlist_bl_for_each_entry_rcu(obj, pos, hash_bl_head(name, key), member)
+
+#endif
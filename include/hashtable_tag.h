@@ -0,0 +1,166 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* hashtable_tag.h - tagged hashtables, after <linux/hashtable.h>.
+ */
+
+#ifndef _HASHTABLE_TAG_H
+#define _HASHTABLE_TAG_H
+
+#include "hashtable.h"
+#include "list_tag.h"
+
+/*
+ * Compact tagged hashtables: buckets are list_tag.h lists, whose links
+ * also hold a 16 bits tag of the pointed node key hash (the hash bits
+ * following the bucket ones). Lookups only read nodes with a matching tag:
+ * most misses do not read any node.
+ * Buckets are either hlist_tag_head (nodes are hlist_tag_node, 16 bytes),
+ * or slist_tag_head (nodes are slist_tag_node, 8 bytes, but removal must
+ * walk the bucket).
+ * Keys are always hashed with 64 bits multiplicative hashing.
+ */
+#define DEFINE_HASHTABLE_TAG(name, bits)					\
+	struct hlist_tag_head name[1 << (bits)] =				\
+			{ [0 ... ((1 << (bits)) - 1)] = HLIST_TAG_HEAD_INIT }
+
+#define DECLARE_HASHTABLE_TAG(name, bits)					\
+	struct hlist_tag_head name[1 << (bits)]
+
+#define DEFINE_HASHTABLE_STAG(name, bits)					\
+	struct slist_tag_head name[1 << (bits)] =				\
+			{ [0 ... ((1 << (bits)) - 1)] = SLIST_TAG_HEAD_INIT }
+
+#define DECLARE_HASHTABLE_STAG(name, bits)					\
+	struct slist_tag_head name[1 << (bits)]
+
+static inline void __hash_init_tag(struct hlist_tag_head *ht, unsigned int sz)
+{
+	unsigned int i;
+
+	for (i = 0; i < sz; i++)
+		INIT_HLIST_TAG_HEAD(&ht[i]);
+}
+
+static inline void __hash_init_stag(struct slist_tag_head *ht, unsigned int sz)
+{
+	unsigned int i;
+
+	for (i = 0; i < sz; i++)
+		INIT_SLIST_TAG_HEAD(&ht[i]);
+}
+
+/**
+ * hash_init_tag - initialize a tagged hash table
+ * @hashtable: hashtable to be initialized
+ */
+#define hash_init_tag(hashtable) __hash_init_tag(hashtable, HASH_SIZE(hashtable))
+
+/**
+ * hash_init_stag - initialize a singly linked tagged hash table
+ * @hashtable: hashtable to be initialized
+ */
+#define hash_init_stag(hashtable) __hash_init_stag(hashtable, HASH_SIZE(hashtable))
+
+/* bucket (high bits) and tag (HLIST_TAG_BITS low bits) of a key */
+static inline u64 __hash_tag(u64 val, unsigned int bits)
+{
+	return val * GOLDEN_RATIO_64 >> (64 - HLIST_TAG_BITS - bits);
+}
+
+#define __hash_tag_bucket(name, h) (&(name)[(h) >> HLIST_TAG_BITS])
+
+/**
+ * hash_add_tag - add an object to a tagged hashtable
+ * @hashtable: hashtable to add to
+ * @node: the &struct hlist_tag_node of the object to be added
+ * @key: the key of the object to be added
+ */
+#define hash_add_tag(hashtable, node, key) do {				\
+	u64 __h = __hash_tag(key, HASH_BITS(hashtable));			\
+	hlist_tag_add_head(node, __hash_tag_bucket(hashtable, __h), (u16) __h);\
+} while (0)
+
+/**
+ * hash_del_tag - remove an object from a tagged hashtable
+ * @node: &struct hlist_tag_node of the object to remove
+ */
+static inline void hash_del_tag(struct hlist_tag_node *node)
+{
+	hlist_tag_del_init(node);
+}
+
+/**
+ * hash_for_each_tag - iterate over a tagged hashtable
+ * @name: hashtable to iterate
+ * @bkt: integer to use as bucket loop cursor
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hlist_tag_node within the struct
+ */
+#define hash_for_each_tag(name, bkt, obj, member)				\
+	for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < HASH_SIZE(name);\
+			(bkt)++)						\
+		hlist_tag_for_each_entry(obj, &name[bkt], member)
+
+/**
+ * hash_for_each_possible_tag - iterate over all possible objects hashing to the
+ * same bucket and tag in a tagged hashtable
+ * @name: hashtable to iterate
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the hlist_tag_node within the struct
+ * @key: the key of the objects to iterate over
+ */
+#define hash_for_each_possible_tag(name, obj, member, key)			\
+	for (u64 __h = __hash_tag(key, HASH_BITS(name)), __once = 1;		\
+	     __once; __once = 0)						\
+		hlist_tag_for_each_entry_tag(obj, __hash_tag_bucket(name, __h),\
+					     member, (u16) __h)
+
+/**
+ * hash_add_stag - add an object to a singly linked tagged hashtable
+ * @hashtable: hashtable to add to
+ * @node: the &struct slist_tag_node of the object to be added
+ * @key: the key of the object to be added
+ */
+#define hash_add_stag(hashtable, node, key) do {				\
+	u64 __h = __hash_tag(key, HASH_BITS(hashtable));			\
+	slist_tag_add_head(node, __hash_tag_bucket(hashtable, __h), (u16) __h);\
+} while (0)
+
+/**
+ * hash_del_stag - remove an object from a singly linked tagged hashtable
+ * @hashtable: hashtable to remove from
+ * @node: the &struct slist_tag_node of the object to remove
+ * @key: the key of the object to remove
+ *
+ * The object bucket is walked. Return: true if object was found.
+ */
+#define hash_del_stag(hashtable, node, key)					\
+	slist_tag_del(node, __hash_tag_bucket(hashtable,			\
+			__hash_tag(key, HASH_BITS(hashtable))))
+
+/**
+ * hash_for_each_stag - iterate over a singly linked tagged hashtable
+ * @name: hashtable to iterate
+ * @bkt: integer to use as bucket loop cursor
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the slist_tag_node within the struct
+ */
+#define hash_for_each_stag(name, bkt, obj, member)				\
+	for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < HASH_SIZE(name);\
+			(bkt)++)						\
+		slist_tag_for_each_entry(obj, &name[bkt], member)
+
+/**
+ * hash_for_each_possible_stag - iterate over all possible objects hashing to
+ * the same bucket and tag in a singly linked tagged hashtable
+ * @name: hashtable to iterate
+ * @obj: the type * to use as a loop cursor for each entry
+ * @member: the name of the slist_tag_node within the struct
+ * @key: the key of the objects to iterate over
+ */
+#define hash_for_each_possible_stag(name, obj, member, key)			\
+	for (u64 __h = __hash_tag(key, HASH_BITS(name)), __once = 1;		\
+	     __once; __once = 0)						\
+		slist_tag_for_each_entry_tag(obj, __hash_tag_bucket(name, __h),\
+					     member, (u16) __h)
+
+#endif
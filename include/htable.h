@@ -0,0 +1,200 @@
+/* htable.h - dynamically resizable hashtables.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Runtime-sized version of hashtable.h: objects embed a struct hlist_node,
+ * and are hashed with hash_64() on a u64 key. The buckets array is allocated
+ * on the heap, and is doubled when the load factor exceeds
+ * HTABLE_MAX_LOAD, or halved when it falls below 1/HTABLE_MIN_LOAD_DIV.
+ *
+ * Rehashing is incremental: on resize, the previous buckets array is kept,
+ * and each following htable_add() or htable_del() moves HTABLE_REHASH_STEP
+ * of its buckets to the new array (HTABLE_MIN_LOAD_DIV times more when
+ * shrinking, as they are mostly empty). Until all buckets are moved, lookups
+ * check both arrays. This way, no single operation pays for a whole rehash.
+ * A resize needed during a rehash is deferred until the rehash is complete.
+ *
+ * To move objects, the table needs their key: it is given by the @key
+ * function passed to htable_init().
+ *
+ * Tables are not thread-safe.
+ */
+
+#ifndef _HTABLE_H
+#define _HTABLE_H
+
+#include "brlib.h"
+#include "list.h"
+#include "hash.h"
+#include "hashstats.h"
+
+#define HTABLE_MIN_BITS     4                     /* 16 buckets */
+#define HTABLE_MAX_BITS     32                    /* hash_64() result is u32 */
+#define HTABLE_MAX_LOAD     1                     /* grow above 1 object/bucket */
+#define HTABLE_MIN_LOAD_DIV 8                     /* shrink below 1/8 */
+#define HTABLE_REHASH_STEP  4                     /* buckets moved per operation */
+
+typedef struct htable {
+    struct hlist_head *buckets;                   /* current buckets */
+    struct hlist_head *old;                       /* buckets being rehashed, or NULL */
+    u32 bits;                                     /* log2(current buckets) */
+    u32 oldbits;                                  /* log2(old buckets) */
+    u32 rehash;                                   /* next old bucket to move */
+    u32 minbits;                                  /* do not shrink below */
+    u64 count;                                    /* objects in table */
+    u64 (*key)(const struct hlist_node *node);    /* object key */
+} htable_t;
+
+/**
+ * htable_init - initialize a hashtable.
+ * @ht:      the hashtable.
+ * @bits:    log2 of initial (and minimum) number of buckets.
+ * @key:     function returning an object key from its hlist_node.
+ *
+ * @bits is at least HTABLE_MIN_BITS, and at most HTABLE_MAX_BITS.
+ *
+ * Return:   0 on success, -1 on error (errno is set to ENOMEM).
+ */
+int htable_init(htable_t *ht, u32 bits, u64 (*key)(const struct hlist_node *node));
+
+/**
+ * htable_free - release hashtable buckets.
+ * @ht:      the hashtable.
+ *
+ * Objects are not released.
+ */
+void htable_free(htable_t *ht);
+
+/**
+ * htable_add - add an object to a hashtable.
+ * @ht:      the hashtable.
+ * @node:    the &struct hlist_node of the object to be added.
+ * @key:     the key of the object to be added.
+ *
+ * If the table needs to grow and memory cannot be allocated, object is still
+ * added: the table just does not grow.
+ */
+void htable_add(htable_t *ht, struct hlist_node *node, u64 key);
+
+/**
+ * htable_del - remove an object from a hashtable.
+ * @ht:      the hashtable.
+ * @node:    the &struct hlist_node of the object to remove.
+ */
+void htable_del(htable_t *ht, struct hlist_node *node);
+
+/**
+ * htable_rehash - complete a pending incremental rehash.
+ * @ht:      the hashtable.
+ */
+void htable_rehash(htable_t *ht);
+
+/**
+ * htable_count - number of objects in hashtable.
+ * @ht:      the hashtable.
+ */
+static inline u64 htable_count(const htable_t *ht)
+{
+    return ht->count;
+}
+
+/**
+ * htable_size - number of buckets in hashtable.
+ * @ht:      the hashtable.
+ *
+ * During a rehash, old buckets are included.
+ */
+static inline u64 htable_size(const htable_t *ht)
+{
+    return (1UL << ht->bits) + (ht->old? 1UL << ht->oldbits: 0);
+}
+
+/**
+ * htable_stats - account hashtable chains (see hashstats.h).
+ * @ht:      the hashtable.
+ * @stats:   the statistics to update.
+ *
+ * During a rehash, old buckets not yet moved are included.
+ */
+void htable_stats(const htable_t *ht, hash_stats_t *stats);
+
+/* htable_for_each*() helpers */
+static inline struct hlist_head *__htable_bucket(const htable_t *ht, u64 idx)
+{
+    u64 size = 1UL << ht->bits;
+
+    return idx < size? ht->buckets + idx: ht->old + idx - size;
+}
+
+static inline struct hlist_head *__htable_first(const htable_t *ht, u64 key)
+{
+    if (ht->old) {
+        u32 bkt = hash_64(key, ht->oldbits);
+
+        if (bkt >= ht->rehash)
+            return ht->old + bkt;
+    }
+    return ht->buckets + hash_64(key, ht->bits);
+}
+
+static inline struct hlist_head *__htable_next(const htable_t *ht, u64 key,
+                                               struct hlist_head *cur)
+{
+    struct hlist_head *head = ht->buckets + hash_64(key, ht->bits);
+
+    return cur == head? NULL: head;
+}
+
+/**
+ * htable_for_each - iterate over a hashtable.
+ * @ht:      the hashtable.
+ * @bkt:     u64 to use as bucket loop cursor.
+ * @obj:     the type * to use as a loop cursor for each entry.
+ * @member:  the name of the hlist_node within the struct.
+ */
+#define htable_for_each(ht, bkt, obj, member)                           \
+    for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < htable_size(ht); \
+         (bkt)++)                                                       \
+        hlist_for_each_entry(obj, __htable_bucket(ht, bkt), member)
+
+/**
+ * htable_for_each_safe - iterate over a hashtable safe against removal of
+ * hash entry.
+ * @ht:      the hashtable.
+ * @bkt:     u64 to use as bucket loop cursor.
+ * @tmp:     a &struct hlist_node used for temporary storage.
+ * @obj:     the type * to use as a loop cursor for each entry.
+ * @member:  the name of the hlist_node within the struct.
+ *
+ * Objects may be removed with hlist_del(), not htable_del() which may move
+ * objects: to empty a table, remove objects this way, then call htable_free().
+ */
+#define htable_for_each_safe(ht, bkt, tmp, obj, member)                 \
+    for ((bkt) = 0, obj = NULL; obj == NULL && (bkt) < htable_size(ht); \
+         (bkt)++)                                                       \
+        hlist_for_each_entry_safe(obj, tmp, __htable_bucket(ht, bkt), member)
+
+/**
+ * htable_for_each_possible - iterate over all possible objects hashing to the
+ * same bucket.
+ * @ht:      the hashtable.
+ * @obj:     the type * to use as a loop cursor for each entry.
+ * @member:  the name of the hlist_node within the struct.
+ * @key:     the key of the objects to iterate over.
+ *
+ * During a rehash, up to two buckets are walked.
+ */
+#define htable_for_each_possible(ht, obj, member, key)                  \
+    for (struct hlist_head *__h = ({ obj = NULL; __htable_first(ht, key); }); \
+         __h && !obj;                                                   \
+         __h = __htable_next(ht, key, __h))                             \
+        hlist_for_each_entry(obj, __h, member)
+
+#endif  /* _HTABLE_H */
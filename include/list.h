@@ -33,6 +33,16 @@ struct hlist_node {
 #define LIST_POISON1  ((void *) 0x100 + POISON_POINTER_DELTA)
 #define LIST_POISON2  ((void *) 0x200 + POISON_POINTER_DELTA)
 
+/************ originally in <include/linux/prefetch.h> */
+/*
+ * prefetch(x) attempts to pre-emptively get the memory pointed to
+ * by address "x" into the CPU L1 cache.
+ * prefetch(x) should not cause any kind of exception, prefetch(0) is
+ * specifically ok.
+ */
+#define prefetch(x)   __builtin_prefetch(x)
+#define prefetchw(x)  __builtin_prefetch(x, 1)
+
 /*
  * Circular doubly linked list implementation.
  *
@@ -728,6 +738,62 @@ static inline void list_splice_tail_init(struct list_head *list,
          !list_entry_is_head(pos, head, member);                \
          pos = n, n = list_prev_entry(n, member))
 
+/*
+ * Prefetching iterators.
+ *
+ * Walking a list is a chain of dependent loads: when nodes are scattered in
+ * memory, each step is a likely cache miss. These variants issue a prefetch
+ * ahead of the loop cursor, so that fetching the following node(s) overlaps
+ * with the loop body. They are useful on long lists with scattered nodes and
+ * some work per node; on short or sequentially allocated lists, they do not
+ * help (hardware prefetcher does the job) and may cost a few cycles.
+ */
+
+/**
+ * list_for_each_prefetch - iterate over a list, prefetching next node
+ * @pos:	the &struct list_head to use as a loop cursor.
+ * @head:	the head for your list.
+ */
+#define list_for_each_prefetch(pos, head)                       \
+    for (pos = (head)->next;                                    \
+         pos != (head) && ({ prefetch(pos->next); 1; });        \
+         pos = pos->next)
+
+/**
+ * list_for_each_entry_prefetch - iterate over list of given type, prefetching
+ *                                next entry
+ * @pos:	the type * to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the list_head within the struct.
+ *
+ * Next entry is prefetched before loop body is executed.
+ */
+#define list_for_each_entry_prefetch(pos, head, member)                 \
+    for (pos = list_first_entry(head, __typeof__(*pos), member);        \
+         !list_entry_is_head(pos, head, member) &&                      \
+             ({ prefetch(pos->member.next); 1; });                      \
+         pos = list_next_entry(pos, member))
+
+/**
+ * list_for_each_entry_prefetch2 - iterate over list of given type, prefetching
+ *                                 next-next entry
+ * @pos:	the type * to use as a loop cursor.
+ * @n:		a &struct list_head to use as temporary storage
+ * @head:	the head for your list.
+ * @member:	the name of the list_head within the struct.
+ *
+ * @n is kept one entry ahead of @pos, and the entry following @n is prefetched
+ * before loop body is executed: the prefetch distance is two entries.
+ * As @n is saved before loop body, this iterator is also safe against removal
+ * of @pos.
+ */
+#define list_for_each_entry_prefetch2(pos, n, head, member)             \
+    for (pos = list_first_entry(head, __typeof__(*pos), member),        \
+             n = pos->member.next;                                      \
+         !list_entry_is_head(pos, head, member) &&                      \
+             ({ prefetch(n->next); 1; });                               \
+         pos = list_entry(n, __typeof__(*pos), member), n = n->next)
+
 /**
  * list_safe_reset_next - reset a stale list_for_each_entry_safe loop
  * @pos:	the loop cursor used in the list_for_each_entry_safe loop
@@ -989,4 +1055,40 @@ static inline void hlist_move_list(struct hlist_head *old,
          pos && ({ n = pos->member.next; 1; });                         \
          pos = hlist_entry_safe(n, __typeof__(*pos), member))
 
+/**
+ * hlist_for_each_prefetch - iterate over a hlist, prefetching next node
+ * @pos:	the &struct hlist_node to use as a loop cursor.
+ * @head:	the head for your list.
+ */
+#define hlist_for_each_prefetch(pos, head)                              \
+    for (pos = (head)->first; pos && ({ prefetch(pos->next); 1; });     \
+         pos = pos->next)
+
+/**
+ * hlist_for_each_entry_prefetch - iterate over list of given type, prefetching
+ *                                 next entry
+ * @pos:	the type * to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ */
+#define hlist_for_each_entry_prefetch(pos, head, member)                \
+    for (pos = hlist_entry_safe((head)->first, __typeof__(*(pos)), member); \
+         pos && ({ prefetch((pos)->member.next); 1; });                 \
+         pos = hlist_entry_safe((pos)->member.next, __typeof__(*(pos)), member))
+
+/**
+ * hlist_for_each_entry_prefetch2 - iterate over list of given type, prefetching
+ *                                  next-next entry
+ * @pos:	the type * to use as a loop cursor.
+ * @n:		a &struct hlist_node to use as temporary storage
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ *
+ * See list_for_each_entry_prefetch2(). Also safe against removal of @pos.
+ */
+#define hlist_for_each_entry_prefetch2(pos, n, head, member)            \
+    for (pos = hlist_entry_safe((head)->first, __typeof__(*(pos)), member); \
+         pos && ({ n = pos->member.next; if (n) prefetch(n->next); 1; }); \
+         pos = hlist_entry_safe(n, __typeof__(*(pos)), member))
+
 #endif  /* __BR_LIST_H */
@@ -0,0 +1,235 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/* adaptation of kernel's <linux/list_bl.h> and <linux/bit_spinlock.h>
+ *
+ */
+#ifndef __BR_LIST_BL_H
+#define __BR_LIST_BL_H
+
+#include <stdint.h>
+#include <sched.h>
+
+#include "list.h"
+#include "likely.h"
+
+/*
+ * Special version of lists, where head of the list has a lock in the lowest
+ * bit. This is useful for scalable hash tables without increasing memory
+ * footprint overhead: each bucket has its own lock, at no memory cost.
+ *
+ * For modification operations, the 0 bit of hlist_bl_head->first
+ * pointer must be set (see hlist_bl_lock()).
+ *
+ * With some small modifications, this can easily be adapted to store several
+ * arbitrary bits (not just a single lock bit), if the need arises to store
+ * some fast and compact auxiliary data.
+ */
+
+#define LIST_BL_LOCKMASK	1UL
+
+#ifdef DEBUG_LIST_BL
+#include "bug.h"
+#define LIST_BL_BUG_ON(x) bug_on_always(x)
+#else
+#define LIST_BL_BUG_ON(x)
+#endif
+
+/* head->first accessed as an integer by lock functions: as lists functions
+ * access it as a pointer, it must not be subject to strict aliasing rules.
+ */
+typedef uintptr_t __attribute__((__may_alias__)) hlist_bl_word_t;
+
+struct hlist_bl_head {
+    struct hlist_bl_node *first;
+};
+
+struct hlist_bl_node {
+    struct hlist_bl_node *next, **pprev;
+};
+
+#define HLIST_BL_HEAD_INIT { .first = NULL }
+#define INIT_HLIST_BL_HEAD(ptr)                 \
+    ((ptr)->first = NULL)
+
+static inline void INIT_HLIST_BL_NODE(struct hlist_bl_node *h)
+{
+    h->next = NULL;
+    h->pprev = NULL;
+}
+
+#define hlist_bl_entry(ptr, type, member) container_of(ptr,type,member)
+
+static inline bool  hlist_bl_unhashed(const struct hlist_bl_node *h)
+{
+    return !h->pprev;
+}
+
+static inline struct hlist_bl_node *hlist_bl_first(struct hlist_bl_head *h)
+{
+    return (struct hlist_bl_node *)
+        ((uintptr_t)h->first & ~LIST_BL_LOCKMASK);
+}
+
+static inline void hlist_bl_set_first(struct hlist_bl_head *h,
+                                      struct hlist_bl_node *n)
+{
+    LIST_BL_BUG_ON((uintptr_t)n & LIST_BL_LOCKMASK);
+    LIST_BL_BUG_ON(((uintptr_t)h->first & LIST_BL_LOCKMASK) !=
+                   LIST_BL_LOCKMASK);
+    h->first = (struct hlist_bl_node *)((uintptr_t)n | LIST_BL_LOCKMASK);
+}
+
+static inline bool hlist_bl_empty(const struct hlist_bl_head *h)
+{
+    return !((uintptr_t)READ_ONCE(h->first) & ~LIST_BL_LOCKMASK);
+}
+
+static inline void hlist_bl_add_head(struct hlist_bl_node *n,
+                                     struct hlist_bl_head *h)
+{
+    struct hlist_bl_node *first = hlist_bl_first(h);
+
+    n->next = first;
+    if (first)
+        first->pprev = &n->next;
+    n->pprev = &h->first;
+    hlist_bl_set_first(h, n);
+}
+
+static inline void hlist_bl_add_before(struct hlist_bl_node *n,
+                                       struct hlist_bl_node *next)
+{
+    struct hlist_bl_node **pprev = next->pprev;
+
+    n->pprev = pprev;
+    n->next = next;
+    next->pprev = &n->next;
+
+    /* pprev may be `first`, so be careful not to lose the lock bit */
+    WRITE_ONCE(*pprev,
+               (struct hlist_bl_node *)
+               ((uintptr_t)n | ((uintptr_t)*pprev & LIST_BL_LOCKMASK)));
+}
+
+static inline void hlist_bl_add_behind(struct hlist_bl_node *n,
+                                       struct hlist_bl_node *prev)
+{
+    n->next = prev->next;
+    n->pprev = &prev->next;
+    prev->next = n;
+
+    if (n->next)
+        n->next->pprev = &n->next;
+}
+
+static inline void __hlist_bl_del(struct hlist_bl_node *n)
+{
+    struct hlist_bl_node *next = n->next;
+    struct hlist_bl_node **pprev = n->pprev;
+
+    LIST_BL_BUG_ON((uintptr_t)n & LIST_BL_LOCKMASK);
+
+    /* pprev may be `first`, so be careful not to lose the lock bit */
+    WRITE_ONCE(*pprev,
+               (struct hlist_bl_node *)
+               ((uintptr_t)next | ((uintptr_t)*pprev & LIST_BL_LOCKMASK)));
+    if (next)
+        next->pprev = pprev;
+}
+
+static inline void hlist_bl_del(struct hlist_bl_node *n)
+{
+    __hlist_bl_del(n);
+    n->next = LIST_POISON1;
+    n->pprev = LIST_POISON2;
+}
+
+static inline void hlist_bl_del_init(struct hlist_bl_node *n)
+{
+    if (!hlist_bl_unhashed(n)) {
+        __hlist_bl_del(n);
+        INIT_HLIST_BL_NODE(n);
+    }
+}
+
+/**
+ * hlist_bl_lock - lock a hlist_bl list.
+ * @b: the list head.
+ *
+ * Spin until lock bit is acquired. As we may run on fewer CPUs than
+ * threads, yield after a few tries.
+ */
+static inline void hlist_bl_lock(struct hlist_bl_head *b)
+{
+    hlist_bl_word_t *p = (hlist_bl_word_t *)&b->first;
+    int spins = 0;
+
+    while (unlikely(__atomic_fetch_or(p, LIST_BL_LOCKMASK, __ATOMIC_ACQUIRE)
+                    & LIST_BL_LOCKMASK)) {
+        do {
+            if (++spins >= 64)
+                sched_yield();
+        } while (__atomic_load_n(p, __ATOMIC_RELAXED) & LIST_BL_LOCKMASK);
+    }
+}
+
+/**
+ * hlist_bl_trylock - try to lock a hlist_bl list.
+ * @b: the list head.
+ *
+ * Return: true if lock was acquired.
+ */
+static inline bool hlist_bl_trylock(struct hlist_bl_head *b)
+{
+    return !(__atomic_fetch_or((hlist_bl_word_t *)&b->first, LIST_BL_LOCKMASK,
+                               __ATOMIC_ACQUIRE) & LIST_BL_LOCKMASK);
+}
+
+/**
+ * hlist_bl_unlock - unlock a hlist_bl list.
+ * @b: the list head.
+ *
+ * Only the lock owner modifies the head: a plain release store is enough.
+ */
+static inline void hlist_bl_unlock(struct hlist_bl_head *b)
+{
+    hlist_bl_word_t *p = (hlist_bl_word_t *)&b->first;
+
+    LIST_BL_BUG_ON(!(*p & LIST_BL_LOCKMASK));
+    __atomic_store_n(p, *p & ~LIST_BL_LOCKMASK, __ATOMIC_RELEASE);
+}
+
+static inline bool hlist_bl_is_locked(struct hlist_bl_head *b)
+{
+    return (uintptr_t)READ_ONCE(b->first) & LIST_BL_LOCKMASK;
+}
+
+/**
+ * hlist_bl_for_each_entry	- iterate over list of given type
+ * @tpos:	the type * to use as a loop cursor.
+ * @pos:	the &struct hlist_node to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ *
+ */
+#define hlist_bl_for_each_entry(tpos, pos, head, member)                \
+    for (pos = hlist_bl_first(head);                                    \
+         pos &&                                                         \
+             ({ tpos = hlist_bl_entry(pos, __typeof__(*tpos), member); 1;}); \
+         pos = pos->next)
+
+/**
+ * hlist_bl_for_each_entry_safe - iterate over list of given type safe against removal of list entry
+ * @tpos:	the type * to use as a loop cursor.
+ * @pos:	the &struct hlist_node to use as a loop cursor.
+ * @n:		another &struct hlist_node to use as temporary storage
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ */
+#define hlist_bl_for_each_entry_safe(tpos, pos, n, head, member)        \
+    for (pos = hlist_bl_first(head);                                    \
+         pos && ({ n = pos->next; 1; }) &&                              \
+             ({ tpos = hlist_bl_entry(pos, __typeof__(*tpos), member); 1;}); \
+         pos = n)
+
+#endif  /* __BR_LIST_BL_H */
@@ -0,0 +1,285 @@
+/* list_tag.h - hash lists with tagged pointers.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Hash lists where each link (list head "first", or node "next") also
+ * stores, in the pointer unused bits:
+ *   - high bits: a 16 bits tag of the node it points to (usually some hash
+ *     bits of the node key).
+ *   - low bit: whether the node it points to is the last one of the list.
+ * Walking a list for a given tag skips non-matching nodes without looking at
+ * their key, and stops on the link to the last node if its tag does not
+ * match: the last node of a list (for instance the only node of most hash
+ * buckets) is never read by a non-matching lookup.
+ *
+ * Two node types are available:
+ *   - hlist_tag_node: doubly linked (16 bytes), like hlist_node: nodes can be
+ *     removed without knowing their list.
+ *   - slist_tag_node: singly linked (8 bytes): removal must walk the list.
+ *
+ * User space addresses must fit in HLIST_TAG_SHIFT (48) bits, which is the
+ * case on x86-64 and aarch64 Linux (unless mmap(2) is explicitly asked for
+ * higher addresses). This is checked with DEBUG_LIST_TAG.
+ */
+
+#ifndef __BR_LIST_TAG_H
+#define __BR_LIST_TAG_H
+
+#include <stdint.h>
+
+#include "brlib.h"
+#include "container-of.h"
+
+#if __WORDSIZE != 64
+#error "list_tag.h needs 64 bits pointers"
+#endif
+
+#define HLIST_TAG_BITS    16
+#define HLIST_TAG_SHIFT   (64 - HLIST_TAG_BITS)
+#define HLIST_TAG_LAST    1UL                     /* pointed node is last */
+#define HLIST_TAG_PTRMASK (((1UL << HLIST_TAG_SHIFT) - 1) & ~HLIST_TAG_LAST)
+
+#ifdef DEBUG_LIST_TAG
+#include "bug.h"
+#define LIST_TAG_BUG_ON(x) bug_on_always(x)
+#else
+#define LIST_TAG_BUG_ON(x)
+#endif
+
+struct hlist_tag_head {
+    uintptr_t first;
+};
+
+struct hlist_tag_node {
+    uintptr_t next;                               /* must be first */
+    uintptr_t *pprev;                             /* bit 0: points to head */
+};
+
+struct slist_tag_head {
+    uintptr_t first;
+};
+
+struct slist_tag_node {
+    uintptr_t next;
+};
+
+#define HLIST_TAG_HEAD_INIT { .first = 0 }
+#define INIT_HLIST_TAG_HEAD(ptr) ((ptr)->first = 0)
+#define SLIST_TAG_HEAD_INIT { .first = 0 }
+#define INIT_SLIST_TAG_HEAD(ptr) ((ptr)->first = 0)
+
+/* tagged pointers helpers */
+static inline uintptr_t tag_ptr_make(const void *ptr, u16 tag, bool last)
+{
+    LIST_TAG_BUG_ON((uintptr_t)ptr & ~HLIST_TAG_PTRMASK);
+    return (uintptr_t)ptr | (uintptr_t)tag << HLIST_TAG_SHIFT | last;
+}
+
+static inline void *tag_ptr(uintptr_t tp)
+{
+    return (void *)(tp & HLIST_TAG_PTRMASK);
+}
+
+static inline u16 tag_ptr_tag(uintptr_t tp)
+{
+    return tp >> HLIST_TAG_SHIFT;
+}
+
+/* follow the links from @tp up to the first one with @tag (or 0). As "next"
+ * is the first member of both node types, this works for both.
+ */
+static inline uintptr_t __tag_find(uintptr_t tp, u16 tag)
+{
+    for (; tp; tp = *(uintptr_t *)tag_ptr(tp)) {
+        if (tag_ptr_tag(tp) == tag)
+            return tp;
+        if (tp & HLIST_TAG_LAST)
+            break;
+    }
+    return 0;
+}
+
+#define hlist_tag_entry(tp, type, member)                               \
+    container_of((typeof(&((type *)0)->member))tag_ptr(tp), type, member)
+
+/* doubly linked tagged lists */
+static inline void INIT_HLIST_TAG_NODE(struct hlist_tag_node *n)
+{
+    n->next = 0;
+    n->pprev = NULL;
+}
+
+static inline bool hlist_tag_unhashed(const struct hlist_tag_node *n)
+{
+    return !n->pprev;
+}
+
+static inline bool hlist_tag_empty(const struct hlist_tag_head *h)
+{
+    return !h->first;
+}
+
+/**
+ * hlist_tag_add_head - add a node at the beginning of a tagged hlist.
+ * @n:   the node to add.
+ * @h:   the list head.
+ * @tag: the node tag.
+ */
+static inline void hlist_tag_add_head(struct hlist_tag_node *n,
+                                      struct hlist_tag_head *h, u16 tag)
+{
+    uintptr_t first = h->first;
+
+    n->next = first;
+    if (first)
+        ((struct hlist_tag_node *)tag_ptr(first))->pprev = &n->next;
+    n->pprev = (uintptr_t *)((uintptr_t)&h->first | 1);
+    h->first = tag_ptr_make(n, tag, !first);
+}
+
+/**
+ * hlist_tag_del_init - remove a node from its tagged hlist, and reinitialize it.
+ * @n:   the node to remove.
+ *
+ * The link pointing to @n is replaced by @n's next one, which describes the
+ * following node. If @n was the last node, the previous one becomes last.
+ */
+static inline void hlist_tag_del_init(struct hlist_tag_node *n)
+{
+    if (!hlist_tag_unhashed(n)) {
+        uintptr_t next = n->next;
+        uintptr_t *pprev = (uintptr_t *)((uintptr_t)n->pprev & ~1UL);
+
+        *pprev = next;
+        if (next) {
+            ((struct hlist_tag_node *)tag_ptr(next))->pprev = n->pprev;
+        } else if (!((uintptr_t)n->pprev & 1)) {
+            /* pprev is the previous node "next", at its start */
+            struct hlist_tag_node *prev = (struct hlist_tag_node *)pprev;
+
+            *(uintptr_t *)((uintptr_t)prev->pprev & ~1UL) |= HLIST_TAG_LAST;
+        }
+        INIT_HLIST_TAG_NODE(n);
+    }
+}
+
+/**
+ * hlist_tag_for_each_entry - iterate over a tagged hlist.
+ * @pos:    the type * to use as a loop cursor (NULL at loop end).
+ * @head:   the head for your list.
+ * @member: the name of the hlist_tag_node within the struct.
+ */
+#define hlist_tag_for_each_entry(pos, head, member)                     \
+    for (uintptr_t __tp = (head)->first;                                \
+         (pos = __tp? hlist_tag_entry(__tp, typeof(*(pos)), member): NULL); \
+         __tp = (pos)->member.next)
+
+/**
+ * hlist_tag_for_each_entry_safe - iterate over a tagged hlist, safe against
+ * removal of list entry.
+ * @pos:    the type * to use as a loop cursor.
+ * @head:   the head for your list.
+ * @member: the name of the hlist_tag_node within the struct.
+ */
+#define hlist_tag_for_each_entry_safe(pos, head, member)                \
+    for (uintptr_t __tp = (head)->first;                                \
+         (pos = __tp? hlist_tag_entry(__tp, typeof(*(pos)), member): NULL) && \
+             ((__tp = (pos)->member.next), 1);)
+
+/**
+ * hlist_tag_for_each_entry_tag - iterate over tagged hlist entries with a tag.
+ * @pos:    the type * to use as a loop cursor.
+ * @head:   the head for your list.
+ * @member: the name of the hlist_tag_node within the struct.
+ * @tag:    the tag.
+ */
+#define hlist_tag_for_each_entry_tag(pos, head, member, tag)            \
+    for (uintptr_t __tp = __tag_find((head)->first, tag);               \
+         (pos = __tp? hlist_tag_entry(__tp, typeof(*(pos)), member): NULL); \
+         __tp = __tag_find((pos)->member.next, tag))
+
+/* singly linked tagged lists */
+static inline bool slist_tag_empty(const struct slist_tag_head *h)
+{
+    return !h->first;
+}
+
+/**
+ * slist_tag_add_head - add a node at the beginning of a tagged slist.
+ * @n:   the node to add.
+ * @h:   the list head.
+ * @tag: the node tag.
+ */
+static inline void slist_tag_add_head(struct slist_tag_node *n,
+                                      struct slist_tag_head *h, u16 tag)
+{
+    n->next = h->first;
+    h->first = tag_ptr_make(n, tag, !n->next);
+}
+
+/**
+ * slist_tag_del - remove a node from a tagged slist.
+ * @n:   the node to remove.
+ * @h:   the list head.
+ *
+ * The list is walked to find @n predecessor. If @n was the last node, the
+ * previous one becomes last.
+ *
+ * Return: true if @n was found and removed.
+ */
+static inline bool slist_tag_del(struct slist_tag_node *n,
+                                 struct slist_tag_head *h)
+{
+    uintptr_t *link = &h->first, *prevlink = NULL;
+
+    while (*link) {
+        if (tag_ptr(*link) == n) {
+            *link = n->next;
+            if (!n->next && prevlink)
+                *prevlink |= HLIST_TAG_LAST;
+            n->next = 0;
+            return true;
+        }
+        prevlink = link;
+        link = &((struct slist_tag_node *)tag_ptr(*link))->next;
+    }
+    return false;
+}
+
+/**
+ * slist_tag_for_each_entry - iterate over a tagged slist.
+ * @pos:    the type * to use as a loop cursor.
+ * @head:   the head for your list.
+ * @member: the name of the slist_tag_node within the struct.
+ */
+#define slist_tag_for_each_entry(pos, head, member)                     \
+    hlist_tag_for_each_entry(pos, head, member)
+
+/**
+ * slist_tag_for_each_entry_safe - iterate over a tagged slist, safe against
+ * removal of list entry.
+ * @pos:    the type * to use as a loop cursor.
+ * @head:   the head for your list.
+ * @member: the name of the slist_tag_node within the struct.
+ */
+#define slist_tag_for_each_entry_safe(pos, head, member)                \
+    hlist_tag_for_each_entry_safe(pos, head, member)
+
+/**
+ * slist_tag_for_each_entry_tag - iterate over tagged slist entries with a tag.
+ * @pos:    the type * to use as a loop cursor.
+ * @head:   the head for your list.
+ * @member: the name of the slist_tag_node within the struct.
+ * @tag:    the tag.
+ */
+#define slist_tag_for_each_entry_tag(pos, head, member, tag)            \
+    hlist_tag_for_each_entry_tag(pos, head, member, tag)
+
+#endif  /* __BR_LIST_TAG_H */
@@ -22,20 +22,101 @@
 
 #define POOL_NAME_LENGTH (16)                     /* max name length including trailing \0 */
 
+/* pool flags, see pool_create_attr()
+ */
+#define POOL_MT          (1 << 0)                 /* thread-safe (per-thread magazines) */
+#define POOL_SLIST       (1 << 1)                 /* singly-linked free list */
+#define POOL_MMAP        (1 << 2)                 /* blocks are anonymous mappings */
+#define POOL_HUGEPAGE    (1 << 3)                 /* huge pages blocks (implies POOL_MMAP) */
+#define POOL_NUMA        (1 << 4)                 /* NUMA-bound blocks (implies POOL_MMAP) */
+#define POOL_CACHELINE   (1 << 5)                 /* one object per cache line */
+#define POOL_RECLAIM     (1 << 6)                 /* free blocks can be released */
+#define POOL_FIXED       (1 << 7)                 /* preallocated, never grows */
+#define POOL_MLOCK       (1 << 8)                 /* blocks are locked in memory */
+#define POOL_LOCKFREE    (1 << 9)                 /* thread-safe (lock-free free list) */
+
+#define POOL_MAG_SIZE    (64)                     /* default magazine size (POOL_MT) */
+#define POOL_HUGEPAGE_SIZE (2UL << 20)            /* huge page size (POOL_HUGEPAGE) */
+#define POOL_CACHELINE_SIZE (64)                  /* cache line size (POOL_CACHELINE) */
+#define POOL_NUMA_NODES  (1024)                   /* max NUMA nodes (POOL_NUMA) */
+#define POOL_LATENCY_BUCKETS (32)                 /* pool_get() latency histogram size */
+
+#define POOL_REDZONE_SIZE (8)                     /* min red zone after objects (POOL_HARDEN) */
+#define POOL_POISON_FREE  (0x6b)                  /* released objects poison (POOL_HARDEN) */
+#define POOL_POISON_RED   (0xbb)                  /* red zones poison (POOL_HARDEN) */
+
+struct pool;
+
 typedef struct {
     struct list_head list_blocks;                 /* list of allocated blocks in pool */
+    struct pool *pool;                            /* owner pool */
+    u32 live;                                     /* objects in use (POOL_RECLAIM) */
+    struct list_head list_free;                   /* partial/empty list (POOL_RECLAIM) */
+    void *first_free;                             /* free objects (POOL_RECLAIM) */
     char data[];                                  /* objects block */
 } block_t;
 
 typedef struct {
+    u32 flags;                                    /* POOL_xxx flags */
+    u32 magsize;                                  /* objects per magazine (POOL_MT) */
+    int numa_node;                                /* NUMA node (POOL_NUMA) */
+    u32 align;                                    /* objects alignment, or 0 */
+    u32 maxempty;                                 /* auto-trim threshold (POOL_RECLAIM) */
+    size_t blocksize;                             /* blocks size, or 0 */
+    size_t linkoff;                               /* free list link offset in objects */
+    void (*ctor)(void *obj);                      /* object constructor, or NULL */
+    void (*dtor)(void *obj);                      /* object destructor, or NULL */
+} pool_attr_t;
+
+/* pool counters, see pool_counters().
+ * latency[0] counts pool_get() calls taking less than 1ns, and latency[i]
+ * (i > 0) the ones taking [2^(i-1), 2^i) ns. The last bucket also counts
+ * longer calls.
+ */
+typedef struct {
+    u64 gets;                                     /* objects obtained */
+    u64 puts;                                     /* objects released */
+    u64 inuse;                                    /* objects in use (gets - puts) */
+    u64 hiwater;                                  /* max objects out of pool core */
+    u64 grows;                                    /* blocks allocated */
+    u64 grow_ns;                                  /* time spent allocating blocks */
+    u64 reserved;                                 /* current bytes in blocks */
+    u64 latency[POOL_LATENCY_BUCKETS];            /* pool_get() log2(ns) histogram */
+} pool_counters_t;
+
+struct pool_depot;
+struct pool_lf;
+
+typedef struct pool {
     char name[POOL_NAME_LENGTH];                  /* pool name */
-    size_t eltsize;                               /* object size */
+    u32 flags;                                    /* POOL_xxx flags */
+    size_t objsize;                               /* usable object size */
+    size_t eltsize;                               /* object size, including padding */
+    size_t align;                                 /* object alignment */
+    size_t dataoff;                               /* objects offset in blocks */
+    size_t linkoff;                               /* free list link offset in objects */
+    void (*ctor)(void *obj);                      /* object constructor, or NULL */
+    void (*dtor)(void *obj);                      /* object destructor, or NULL */
     u32 available;                                /* current available elements */
+    u32 uncarved;                                 /* never used elements in last block */
     u32 allocated;                                /* total objects allocated */
     u32 growsize;                                 /* number of objects per block allocated */
     u32 nblocks;                                  /* number of blocks allocated */
+    u32 nempty;                                   /* blocks in list_empty */
+    u32 maxempty;                                 /* auto-trim threshold */
+    size_t blocksize;                             /* block size, including header */
+    size_t blockalign;                            /* block alignment */
+    size_t reclaimed;                             /* total bytes released by trim */
+    int numa_node;                                /* NUMA node (POOL_NUMA) */
     struct list_head list_available;              /* available nodes */
+    void *first_available;                        /* available nodes (POOL_SLIST) */
+    char *carve;                                  /* next never used element */
     struct list_head list_blocks;                 /* allocated blocks */
+    struct list_head list_partial;                /* blocks with free and live objects */
+    struct list_head list_empty;                  /* blocks with free objects only */
+    struct pool_depot *depot;                     /* magazines depot (POOL_MT), or NULL */
+    struct pool_lf *lf;                           /* lock-free stack (POOL_LOCKFREE), or NULL */
+    pool_counters_t *counters;                    /* counters (POOL_STATS), or NULL */
 } pool_t;
 
 /**
@@ -44,6 +125,47 @@ typedef struct {
  */
 void pool_stats(pool_t *pool);
 
+/**
+ * pool_counters - get pool counters
+ * @pool:    the pool address.
+ * @counters: the counters to fill.
+ *
+ * Counters are maintained only if the library is compiled with POOL_STATS
+ * defined. The pool_get() latency histogram is maintained only if the library
+ * is compiled with POOL_STATS_LATENCY defined (which implies POOL_STATS), and
+ * is zeroed otherwise. Without POOL_STATS, no counter code is compiled at
+ * all.
+ * For POOL_MT pools, @hiwater counts objects cached in threads magazines as
+ * out of pool core. For POOL_LOCKFREE pools, @hiwater is the maximum of
+ * @gets - @puts after each pool_get(), and may be slightly overestimated with
+ * concurrent gets. Other counters are exact, but may be slightly outdated if
+ * other threads are using the pool.
+ *
+ * Return:   0 if success, -1 if counters are not available (errno is set to
+ *           ENOTSUP).
+ */
+int pool_counters(pool_t *pool, pool_counters_t *counters);
+
+/**
+ * Hardened mode: if the library is compiled with POOL_HARDEN defined, the
+ * following checks are done on every pool, and any failure is reported on
+ * stderr before calling abort(3):
+ * - pool_add() checks that the object belongs to one of the pool blocks, and
+ *   is at an object boundary.
+ * - each block keeps a bitmap of its objects in use: releasing a free object
+ *   (double free) or getting an object in use (corrupted free list) fails.
+ * - released objects are poisoned with POOL_POISON_FREE. pool_get() checks
+ *   that the poison (except the free list link) is intact, to catch writes
+ *   after release. Pools with a constructor are not poisoned.
+ * - objects are followed by a red zone of at least POOL_REDZONE_SIZE bytes,
+ *   poisoned with POOL_POISON_RED, and checked on pool_get() and pool_add(),
+ *   to catch overflows.
+ * Blocks are fully poisoned when allocated, objects are larger, and finding an
+ * object's block scans the blocks list (also for POOL_RECLAIM pools, so that
+ * foreign addresses are never dereferenced).
+ * Without POOL_HARDEN, no check code is compiled at all.
+ */
+
 /**
  * pool_create - create a new memory pool
  * @name:    the name to give to the pool.
@@ -56,16 +178,126 @@ void pool_stats(pool_t *pool);
  */
 pool_t *pool_create(const char *name, u32 grow, size_t size);
 
+/**
+ * pool_create_attr - create a new memory pool with attributes
+ * @name:    the name to give to the pool.
+ * @grow:    the number of elements to add when no more available.
+ * @size:    the size of an element in pool.
+ * @attr:    the pool attributes, or NULL for defaults.
+ *
+ * Same as pool_create(), with extra attributes. pool_create(name, grow, size)
+ * is pool_create_attr(name, grow, size, NULL).
+ *
+ * POOL_SLIST: available objects are kept in a singly-linked stack, using
+ * only the first pointer of each free object, instead of a struct list_head.
+ * Objects can be as small as a pointer, and pool_get()/pool_add() only write
+ * to the object itself, never to its free neighbours.
+ *
+ * @attr->linkoff: offset of the free list link (a struct list_head, or a
+ * pointer for POOL_SLIST and POOL_RECLAIM) in objects, default 0. It must be
+ * pointer-aligned, and the link must fit in the object. Free objects content
+ * is preserved, except the link.
+ * @attr->ctor: if not NULL, called once for each object, when it is carved
+ * from its block, before its first pool_get(). Objects must be released in
+ * their constructed state, and are returned as is by pool_get(): this saves
+ * the initialization of objects, as kmem_cache constructors do. The link area
+ * (see @attr->linkoff) is not preserved while the object is free, and should
+ * be a field which does not need construction.
+ * @attr->dtor: if not NULL, called for each carved object when its block is
+ * released, by pool_trim() or pool_destroy().
+ *
+ * @attr->blocksize: if not zero, the size of blocks (including their header),
+ * instead of the size needed for @grow objects: @grow is ignored, and blocks
+ * hold as many objects as possible. It is rounded up as computed sizes are
+ * (see POOL_MMAP and POOL_RECLAIM below).
+ *
+ * @attr->align: if not zero, must be a power of two. Blocks data start and
+ * objects size are aligned on @attr->align.
+ * POOL_CACHELINE: objects are aligned on POOL_CACHELINE_SIZE, so that two
+ * objects never share a cache line. This is useful for objects written by
+ * different threads, to avoid false sharing.
+ *
+ * POOL_RECLAIM: blocks without objects in use can be released with
+ * pool_trim(). Blocks size is rounded up to a power of two, @grow is adjusted
+ * to use the whole block, and blocks are aligned on their size, so that an
+ * object's block is found by masking its address. Free objects are kept in
+ * their block (objects of partially used blocks are used first), so that
+ * blocks without objects in use are known without looking at objects. If
+ * @attr->maxempty is not zero, each release making more than
+ * @attr->maxempty blocks free also releases the oldest free block.
+ *
+ * POOL_MMAP: blocks are allocated with anonymous mmap() instead of malloc(),
+ * and are page-aligned. The block size is rounded up to a page size, and @grow
+ * is adjusted to use the whole block.
+ * POOL_HUGEPAGE: blocks are allocated with huge pages (MAP_HUGETLB) if
+ * possible, otherwise they are POOL_HUGEPAGE_SIZE-aligned, and transparent huge
+ * pages are requested with madvise(MADV_HUGEPAGE). Block size is rounded up to
+ * POOL_HUGEPAGE_SIZE.
+ * POOL_NUMA: blocks memory is bound to @attr->numa_node NUMA node, which
+ * must be lower than POOL_NUMA_NODES. If a block cannot be bound (mbind(2)
+ * failure, for instance on a kernel without NUMA support), its allocation
+ * fails with errno set by mbind(2): memory is never silently allocated on
+ * another node.
+ *
+ * POOL_FIXED: one block of (at least) @grow objects is allocated and its
+ * pages are prefaulted at creation, and the pool never grows: pool_get() and
+ * pool_get_bulk() never allocate memory, and fail immediately (with errno set
+ * to ENOBUFS) when the pool is exhausted. The pool is never trimmed. For
+ * POOL_MT pools, objects cached in other threads magazines are not available.
+ * POOL_MLOCK: blocks are locked in memory with mlock(2) when allocated, which
+ * also prefaults them. Block allocation fails if the lock fails (see
+ * RLIMIT_MEMLOCK). With POOL_FIXED, pool creation fails.
+ *
+ * POOL_MT: the pool can be used concurrently by several threads. Each thread
+ * gets two private magazines (small LIFO caches of @attr->magsize objects),
+ * and pool_get()/pool_add() only touch these magazines in the common case.
+ * Full and empty magazines are exchanged with a shared depot, under a lock,
+ * once every @attr->magsize operations at most. If @attr->magsize is 0,
+ * POOL_MAG_SIZE is used.
+ * POOL_LOCKFREE: the pool can be used concurrently by several threads, and
+ * objects can be released by any thread, without lock: free objects are
+ * kept in a single Treiber stack (implies POOL_SLIST), whose top pointer is
+ * tagged with a modification counter in its 16 high bits, to avoid the ABA
+ * problem. A lock is only taken to grow the pool, and all objects of a new
+ * block are carved at once. Blocks are never released: POOL_LOCKFREE cannot
+ * be used with POOL_MT or POOL_RECLAIM. The available objects count is not
+ * maintained (it is always 0, and not displayed by pool_stats()). Objects
+ * addresses must fit in 48 bits: a block at a higher address is released,
+ * and the pool fails to grow (errno is set to ENOMEM).
+ *
+ * Return:   The address of the created pool, or NULL if error.
+ */
+pool_t *pool_create_attr(const char *name, u32 grow, size_t size,
+                         const pool_attr_t *attr);
+
 /**
  * pool_get() - Get an element from a pool.
  * @pool:    The pool address.
  *
- * Get an object from the pool.
+ * Get an object from the pool. Previously released objects are used first.
+ * Otherwise, never used objects are carved from the last allocated block, and
+ * a new block is allocated when it is exhausted. Growing the pool costs one
+ * allocation, whatever the number of elements per block.
+ * POOL_FIXED pools never grow: NULL is returned when no object is available.
  *
  * Return:   The address of the object, or NULL if error.
  */
 void *pool_get(pool_t *pool);
 
+/**
+ * pool_get_bulk() - Get several elements from a pool.
+ * @pool:    The pool address.
+ * @objs:    The array of pointers to fill.
+ * @n:       The number of objects to get.
+ *
+ * Same as calling pool_get() @n times, but the available objects are detached
+ * from pool in one operation, and the pool grows at most once per block.
+ *
+ * Return:   The number of objects stored in @objs. It is lower than @n only if
+ *           the pool could not grow (errno is set).
+ */
+u32 pool_get_bulk(pool_t *pool, void **objs, u32 n);
+
 /**
  * pool_add() - Add (free) an element to a pool.
  * @pool:    The pool address.
@@ -74,10 +306,40 @@ void *pool_get(pool_t *pool);
  * The object will be available for further pool_get().
  *
  * Return:   The current number of available elements in pool (including
- *           @elt).
+ *           @elt). For POOL_MT pools, the number of elements in the current
+ *           thread magazine. For POOL_LOCKFREE pools, 0.
  */
 u32 pool_add(pool_t *pool, void *elt);
 
+/**
+ * pool_add_bulk() - Add (free) several elements to a pool.
+ * @pool:    The pool address.
+ * @objs:    The array of objects to add to the pool.
+ * @n:       The number of objects in @objs.
+ *
+ * Same as calling pool_add() for each object in @objs, but the objects are
+ * chained together first, and spliced to the pool in one operation.
+ *
+ * Return:   Same as pool_add().
+ */
+u32 pool_add_bulk(pool_t *pool, void **objs, u32 n);
+
+/**
+ * pool_trim() - release free blocks.
+ * @pool:    The pool address.
+ * @keep:    The number of free blocks to keep.
+ *
+ * For POOL_RECLAIM pools, blocks which do not contain any object in use are
+ * released, except @keep of them. The released memory is returned to the
+ * system (malloc(3) or munmap(2)), and is reported by pool_stats().
+ * The cost is proportional to the number of released blocks (and to their
+ * number of objects, for pools with a destructor).
+ * For POOL_MT pools, objects cached in thread magazines are considered in use.
+ *
+ * Return:   The number of bytes released.
+ */
+size_t pool_trim(pool_t *pool, u32 keep);
+
 /**
  * pool_destroy() - destroy a pool.
  * @pool:    The pool address.
@@ -85,6 +347,8 @@ u32 pool_add(pool_t *pool, void *elt);
  * Attention: All memory is freed, but no check is done whether all pool
  * elements have been released. Referencing any pool object after this call
  * will likely imply some memory corruption.
+ * For POOL_MT pools, no other thread may use the pool during or after this
+ * call.
  */
 void pool_destroy(pool_t *pool);
 
@@ -0,0 +1,136 @@
+/* rcu.h - userspace read-copy-update.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Epoch-based RCU: readers never write shared memory nor take locks, so that
+ * read-side critical sections scale with the number of threads. Writers
+ * serialize between themselves (with their own lock), publish changes with
+ * rcu_assign_pointer() or the *_rcu() list helpers (see rculist.h), and
+ * reclaim removed objects after a grace period, with synchronize_rcu() or
+ * call_rcu().
+ *
+ * Grace periods: a global counter is incremented by synchronize_rcu(). On its
+ * outermost rcu_read_lock(), a reader copies this counter into its own
+ * (cache-line aligned) slot, and clears it on its outermost rcu_read_unlock().
+ * synchronize_rcu() waits until every reader slot is either clear or
+ * not older than the new counter value.
+ *
+ * Threads are registered on their first rcu_read_lock(), and unregistered on
+ * exit.
+ * synchronize_rcu(), call_rcu() and rcu_barrier() must not be called within
+ * a read-side critical section.
+ */
+
+#ifndef _RCU_H
+#define _RCU_H
+
+#include "brlib.h"
+#include "list.h"
+#include "likely.h"
+
+/* per-thread reader state */
+struct rcu_reader {
+    u64 ctr;                                      /* epoch at lock, or 0 */
+    u32 nesting;                                  /* read-side nesting */
+    struct list_head list;                        /* readers list */
+} __aligned(64);
+
+/* deferred reclaim, to embed in RCU-protected objects */
+struct rcu_head {
+    struct rcu_head *next;
+    void (*func)(struct rcu_head *head);
+};
+
+#define RCU_BATCH 64                              /* call_rcu() batch size */
+
+extern __thread struct rcu_reader *rcu_reader;
+extern u64 rcu_gp_ctr;
+
+struct rcu_reader *__rcu_register(void);
+
+/**
+ * rcu_assign_pointer - publish a pointer to RCU readers.
+ * @p:     the pointer to assign to.
+ * @v:     the value.
+ *
+ * Initialization of *@v is visible to readers which see @v.
+ */
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/**
+ * rcu_dereference - fetch an RCU-protected pointer.
+ * @p:     the pointer to read.
+ *
+ * Must be used within a read-side critical section.
+ */
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_CONSUME)
+
+/**
+ * rcu_access_pointer - fetch an RCU-protected pointer, without dereferencing it.
+ * @p:     the pointer to read.
+ */
+#define rcu_access_pointer(p) READ_ONCE(p)
+
+/**
+ * rcu_read_lock - enter a read-side critical section.
+ *
+ * Read-side critical sections may be nested.
+ */
+static inline void rcu_read_lock(void)
+{
+    struct rcu_reader *reader = rcu_reader;
+
+    if (unlikely(!reader))
+        reader = __rcu_register();
+    if (!reader->nesting++) {
+        __atomic_store_n(&reader->ctr, __atomic_load_n(&rcu_gp_ctr, __ATOMIC_RELAXED),
+                         __ATOMIC_RELAXED);
+        /* order slot store before critical section loads */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+/**
+ * rcu_read_unlock - leave a read-side critical section.
+ */
+static inline void rcu_read_unlock(void)
+{
+    struct rcu_reader *reader = rcu_reader;
+
+    if (!--reader->nesting)
+        __atomic_store_n(&reader->ctr, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * synchronize_rcu - wait for a grace period.
+ *
+ * Return when all read-side critical sections which started before the call
+ * have completed.
+ */
+void synchronize_rcu(void);
+
+/**
+ * call_rcu - reclaim an object after a grace period.
+ * @head:  the rcu_head embedded in object.
+ * @func:  the function called with @head after the grace period.
+ *
+ * Callbacks are batched: every RCU_BATCH calls, the calling thread waits for
+ * a grace period and runs the pending callbacks.
+ */
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head));
+
+/**
+ * rcu_barrier - run all pending call_rcu() callbacks.
+ *
+ * Wait for a grace period and run the pending callbacks.
+ */
+void rcu_barrier(void);
+
+#endif  /* _RCU_H */
@@ -0,0 +1,382 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/* adaptation of kernel's <linux/rculist.h>
+ *
+ * RCU-protected list version. Writers must serialize between themselves;
+ * readers use the *_rcu() iterators within rcu_read_lock()/rcu_read_unlock().
+ * Removed entries must not be freed or reused before a grace period, see
+ * synchronize_rcu() and call_rcu() in rcu.h.
+ */
+#ifndef __BR_RCULIST_H
+#define __BR_RCULIST_H
+
+#include "list.h"
+#include "rcu.h"
+
+/*
+ * INIT_LIST_HEAD_RCU - Initialize a list_head visible to RCU readers
+ * @list: list to be initialized
+ *
+ * You should instead use INIT_LIST_HEAD() for normal initialization and
+ * cleanup tasks, when readers have no access to the list being initialized.
+ * However, if the list being initialized is visible to readers, you
+ * need to keep the compiler from being too mischievous.
+ */
+static inline void INIT_LIST_HEAD_RCU(struct list_head *list)
+{
+    WRITE_ONCE(list->next, list);
+    WRITE_ONCE(list->prev, list);
+}
+
+/*
+ * return the ->next pointer of a list_head in an rcu safe
+ * way, we must not access it directly
+ */
+#define list_next_rcu(list)	(*((struct list_head **)(&(list)->next)))
+
+/**
+ * list_tail_rcu - returns the prev pointer of the head of the list
+ * @head: the head of the list
+ *
+ * Note: This should only be used with the list header, and even then
+ * only if list_del() and similar primitives are not also used on the
+ * list header.
+ */
+#define list_tail_rcu(head)	(*((struct list_head **)(&(head)->prev)))
+
+/*
+ * Insert a new entry between two known consecutive entries.
+ *
+ * This is only for internal list manipulation where we know
+ * the prev/next entries already!
+ */
+static inline void __list_add_rcu(struct list_head *new,
+                                  struct list_head *prev, struct list_head *next)
+{
+    new->next = next;
+    new->prev = prev;
+    rcu_assign_pointer(list_next_rcu(prev), new);
+    next->prev = new;
+}
+
+/**
+ * list_add_rcu - add a new entry to rcu-protected list
+ * @new: new entry to be added
+ * @head: list head to add it after
+ *
+ * Insert a new entry after the specified head.
+ * This is good for implementing stacks.
+ *
+ * The caller must take whatever precautions are necessary
+ * (such as holding appropriate locks) to avoid racing
+ * with another list-mutation primitive, such as list_add_rcu()
+ * or list_del_rcu(), running on this same list.
+ * However, it is perfectly legal to run concurrently with
+ * the _rcu list-traversal primitives, such as
+ * list_for_each_entry_rcu().
+ */
+static inline void list_add_rcu(struct list_head *new, struct list_head *head)
+{
+    __list_add_rcu(new, head, head->next);
+}
+
+/**
+ * list_add_tail_rcu - add a new entry to rcu-protected list
+ * @new: new entry to be added
+ * @head: list head to add it before
+ *
+ * Insert a new entry before the specified head.
+ * This is useful for implementing queues.
+ *
+ * The same locking rules as list_add_rcu() apply.
+ */
+static inline void list_add_tail_rcu(struct list_head *new,
+                                     struct list_head *head)
+{
+    __list_add_rcu(new, head->prev, head);
+}
+
+/**
+ * list_del_rcu - deletes entry from list without re-initialization
+ * @entry: the element to delete from the list.
+ *
+ * Note: list_empty() on entry does not return true after this,
+ * the entry is in an undefined state. It is useful for RCU based
+ * lockfree traversal.
+ *
+ * In particular, it means that we can not poison the forward
+ * pointers that may still be used for walking the list.
+ *
+ * The same locking rules as list_add_rcu() apply.
+ *
+ * Note that the caller is not permitted to immediately free
+ * the newly deleted entry.  Instead, either synchronize_rcu()
+ * or call_rcu() must be used to defer freeing until an RCU
+ * grace period has elapsed.
+ */
+static inline void list_del_rcu(struct list_head *entry)
+{
+    __list_del_entry(entry);
+    entry->prev = LIST_POISON2;
+}
+
+/**
+ * list_replace_rcu - replace old entry by new one
+ * @old : the element to be replaced
+ * @new : the new element to insert
+ *
+ * The @old entry will be replaced with the @new entry atomically.
+ * Note: @old should not be empty.
+ */
+static inline void list_replace_rcu(struct list_head *old,
+                                    struct list_head *new)
+{
+    new->next = old->next;
+    new->prev = old->prev;
+    rcu_assign_pointer(list_next_rcu(new->prev), new);
+    new->next->prev = new;
+    old->prev = LIST_POISON2;
+}
+
+/**
+ * list_entry_rcu - get the struct for this entry
+ * @ptr:        the &struct list_head pointer.
+ * @type:       the type of the struct this is embedded in.
+ * @member:     the name of the list_head within the struct.
+ *
+ * This primitive may safely run concurrently with the _rcu list-mutation
+ * primitives such as list_add_rcu() as long as it's guarded by rcu_read_lock().
+ */
+#define list_entry_rcu(ptr, type, member)                       \
+    container_of(rcu_dereference(ptr), type, member)
+
+/**
+ * list_first_or_null_rcu - get the first element from a list
+ * @ptr:        the list head to take the element from.
+ * @type:       the type of the struct this is embedded in.
+ * @member:     the name of the list_head within the struct.
+ *
+ * Note that if the list is empty, it returns NULL.
+ *
+ * This primitive may safely run concurrently with the _rcu list-mutation
+ * primitives such as list_add_rcu() as long as it's guarded by rcu_read_lock().
+ */
+#define list_first_or_null_rcu(ptr, type, member)                       \
+    ({                                                                  \
+        struct list_head *__ptr = (ptr);                                \
+        struct list_head *__next = READ_ONCE(__ptr->next);              \
+        likely(__ptr != __next) ? list_entry_rcu(__next, type, member) : NULL; \
+    })
+
+/**
+ * list_for_each_entry_rcu - iterate over rcu list of given type
+ * @pos:	the type * to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the list_head within the struct.
+ * @cond:	optional lockdep expression (ignored here).
+ *
+ * This list-traversal primitive may safely run concurrently with
+ * the _rcu list-mutation primitives such as list_add_rcu()
+ * as long as the traversal is guarded by rcu_read_lock().
+ */
+#define list_for_each_entry_rcu(pos, head, member, cond...)             \
+    for (pos = list_entry_rcu((head)->next, __typeof__(*pos), member);  \
+         &pos->member != (head);                                        \
+         pos = list_entry_rcu(pos->member.next, __typeof__(*pos), member))
+
+/**
+ * list_for_each_entry_continue_rcu - continue iteration over list of given type
+ * @pos:	the type * to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the list_head within the struct.
+ *
+ * Continue to iterate over list of given type, continuing after
+ * the current position which must have been in the list when the RCU read
+ * lock was taken.
+ */
+#define list_for_each_entry_continue_rcu(pos, head, member)             \
+    for (pos = list_entry_rcu(pos->member.next, __typeof__(*pos), member); \
+         &pos->member != (head);                                        \
+         pos = list_entry_rcu(pos->member.next, __typeof__(*pos), member))
+
+#define hlist_first_rcu(head)	(*((struct hlist_node **)(&(head)->first)))
+#define hlist_next_rcu(node)	(*((struct hlist_node **)(&(node)->next)))
+#define hlist_pprev_rcu(node)	(*((struct hlist_node **)((node)->pprev)))
+
+/**
+ * hlist_del_rcu - deletes entry from hash list without re-initialization
+ * @n: the element to delete from the hash list.
+ *
+ * Note: hlist_unhashed() on entry does not return true after this,
+ * the entry is in an undefined state. It is useful for RCU based
+ * lockfree traversal.
+ *
+ * In particular, it means that we can not poison the forward
+ * pointers that may still be used for walking the hash list.
+ *
+ * The caller must take whatever precautions are necessary
+ * (such as holding appropriate locks) to avoid racing
+ * with another list-mutation primitive, such as hlist_add_head_rcu()
+ * or hlist_del_rcu(), running on this same list.
+ * However, it is perfectly legal to run concurrently with
+ * the _rcu list-traversal primitives, such as
+ * hlist_for_each_entry().
+ */
+static inline void hlist_del_rcu(struct hlist_node *n)
+{
+    __hlist_del(n);
+    WRITE_ONCE(n->pprev, LIST_POISON2);
+}
+
+/**
+ * hlist_del_init_rcu - deletes entry from hash list with re-initialization
+ * @n: the element to delete from the hash list.
+ *
+ * Note: hlist_unhashed() on the node return true after this. It is
+ * useful for RCU based read lockfree traversal if the writer side
+ * must know if the list entry is still hashed or already unhashed.
+ *
+ * In particular, it means that we can not poison the forward pointers
+ * that may still be used for walking the hash list and we can only
+ * zero the pprev pointer so list_unhashed() will return true after
+ * this.
+ */
+static inline void hlist_del_init_rcu(struct hlist_node *n)
+{
+    if (!hlist_unhashed(n)) {
+        __hlist_del(n);
+        WRITE_ONCE(n->pprev, NULL);
+    }
+}
+
+/**
+ * hlist_replace_rcu - replace old entry by new one
+ * @old : the element to be replaced
+ * @new : the new element to insert
+ *
+ * The @old entry will be replaced with the @new entry atomically.
+ */
+static inline void hlist_replace_rcu(struct hlist_node *old,
+                                     struct hlist_node *new)
+{
+    struct hlist_node *next = old->next;
+
+    new->next = next;
+    WRITE_ONCE(new->pprev, old->pprev);
+    rcu_assign_pointer(*(struct hlist_node **)new->pprev, new);
+    if (next)
+        WRITE_ONCE(new->next->pprev, &new->next);
+    WRITE_ONCE(old->pprev, LIST_POISON2);
+}
+
+/**
+ * hlist_add_head_rcu
+ * @n: the element to add to the hash list.
+ * @h: the list to add to.
+ *
+ * Adds the specified element to the specified hlist,
+ * while permitting racing traversals.
+ *
+ * The caller must take whatever precautions are necessary
+ * (such as holding appropriate locks) to avoid racing
+ * with another list-mutation primitive, such as hlist_add_head_rcu()
+ * or hlist_del_rcu(), running on this same list.
+ * However, it is perfectly legal to run concurrently with
+ * the _rcu list-traversal primitives, such as
+ * hlist_for_each_entry_rcu(), used to prevent memory-consistency
+ * problems on Alpha CPUs.  Regardless of the type of CPU, the
+ * list-traversal primitive must be guarded by rcu_read_lock().
+ */
+static inline void hlist_add_head_rcu(struct hlist_node *n,
+                                      struct hlist_head *h)
+{
+    struct hlist_node *first = h->first;
+
+    n->next = first;
+    WRITE_ONCE(n->pprev, &h->first);
+    rcu_assign_pointer(hlist_first_rcu(h), n);
+    if (first)
+        WRITE_ONCE(first->pprev, &n->next);
+}
+
+/**
+ * hlist_add_before_rcu
+ * @n: the new element to add to the hash list.
+ * @next: the existing element to add the new element before.
+ *
+ * Adds the specified element to the specified hlist
+ * before the specified node while permitting racing traversals.
+ *
+ * The same locking rules as hlist_add_head_rcu() apply.
+ */
+static inline void hlist_add_before_rcu(struct hlist_node *n,
+                                        struct hlist_node *next)
+{
+    WRITE_ONCE(n->pprev, next->pprev);
+    n->next = next;
+    rcu_assign_pointer(hlist_pprev_rcu(n), n);
+    WRITE_ONCE(next->pprev, &n->next);
+}
+
+/**
+ * hlist_add_behind_rcu
+ * @n: the new element to add to the hash list.
+ * @prev: the existing element to add the new element after.
+ *
+ * Adds the specified element to the specified hlist
+ * after the specified node while permitting racing traversals.
+ *
+ * The same locking rules as hlist_add_head_rcu() apply.
+ */
+static inline void hlist_add_behind_rcu(struct hlist_node *n,
+                                        struct hlist_node *prev)
+{
+    n->next = prev->next;
+    WRITE_ONCE(n->pprev, &prev->next);
+    rcu_assign_pointer(hlist_next_rcu(prev), n);
+    if (n->next)
+        WRITE_ONCE(n->next->pprev, &n->next);
+}
+
+/**
+ * hlist_for_each_entry_rcu - iterate over rcu list of given type
+ * @pos:	the type * to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ * @cond:	optional lockdep expression (ignored here).
+ *
+ * This list-traversal primitive may safely run concurrently with
+ * the _rcu list-mutation primitives such as hlist_add_head_rcu()
+ * as long as the traversal is guarded by rcu_read_lock().
+ */
+#define hlist_for_each_entry_rcu(pos, head, member, cond...)            \
+    for (pos = hlist_entry_safe(rcu_dereference(hlist_first_rcu(head)), \
+                                __typeof__(*(pos)), member);            \
+         pos;                                                           \
+         pos = hlist_entry_safe(rcu_dereference(hlist_next_rcu(&(pos)->member)), \
+                                __typeof__(*(pos)), member))
+
+/**
+ * hlist_for_each_entry_rcu_notrace - iterate over rcu list of given type
+ * @pos:	the type * to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_node within the struct.
+ *
+ * Same as hlist_for_each_entry_rcu(), there is no tracing here.
+ */
+#define hlist_for_each_entry_rcu_notrace(pos, head, member)             \
+    hlist_for_each_entry_rcu(pos, head, member)
+
+/**
+ * hlist_for_each_entry_continue_rcu - iterate over a hlist continuing after current point
+ * @pos:	the type * to use as a loop cursor.
+ * @member:	the name of the hlist_node within the struct.
+ */
+#define hlist_for_each_entry_continue_rcu(pos, member)                  \
+    for (pos = hlist_entry_safe(rcu_dereference(hlist_next_rcu(&(pos)->member)), \
+                                __typeof__(*(pos)), member);            \
+         pos;                                                           \
+         pos = hlist_entry_safe(rcu_dereference(hlist_next_rcu(&(pos)->member)), \
+                                __typeof__(*(pos)), member))
+
+#endif  /* __BR_RCULIST_H */
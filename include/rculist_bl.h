@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/* adaptation of kernel's <linux/rculist_bl.h>
+ *
+ * RCU-protected bit-locked lists: writers hold the list lock (see
+ * hlist_bl_lock()), readers walk the list locklessly within
+ * rcu_read_lock()/rcu_read_unlock().
+ */
+#ifndef __BR_RCULIST_BL_H
+#define __BR_RCULIST_BL_H
+
+#include "list_bl.h"
+#include "rcu.h"
+
+static inline void hlist_bl_set_first_rcu(struct hlist_bl_head *h,
+                                          struct hlist_bl_node *n)
+{
+    LIST_BL_BUG_ON((uintptr_t)n & LIST_BL_LOCKMASK);
+    LIST_BL_BUG_ON(((uintptr_t)h->first & LIST_BL_LOCKMASK) !=
+                   LIST_BL_LOCKMASK);
+    rcu_assign_pointer(h->first,
+                       (struct hlist_bl_node *)((uintptr_t)n | LIST_BL_LOCKMASK));
+}
+
+static inline struct hlist_bl_node *hlist_bl_first_rcu(struct hlist_bl_head *h)
+{
+    return (struct hlist_bl_node *)
+        ((uintptr_t)rcu_dereference(h->first) & ~LIST_BL_LOCKMASK);
+}
+
+/**
+ * hlist_bl_del_rcu - deletes entry from hash list without re-initialization
+ * @n: the element to delete from the hash list.
+ *
+ * Note: hlist_bl_unhashed() on entry does not return true after this,
+ * the entry is in an undefined state. It is useful for RCU based
+ * lockfree traversal.
+ *
+ * In particular, it means that we can not poison the forward
+ * pointers that may still be used for walking the hash list.
+ *
+ * The caller must hold the list lock. Readers may run concurrently with
+ * hlist_bl_for_each_entry_rcu().
+ */
+static inline void hlist_bl_del_rcu(struct hlist_bl_node *n)
+{
+    __hlist_bl_del(n);
+    n->pprev = LIST_POISON2;
+}
+
+/**
+ * hlist_bl_add_head_rcu
+ * @n: the element to add to the hash list.
+ * @h: the list to add to.
+ *
+ * Adds the specified element to the specified hlist_bl,
+ * while permitting racing traversals.
+ *
+ * The caller must hold the list lock. Readers may run concurrently with
+ * hlist_bl_for_each_entry_rcu().
+ */
+static inline void hlist_bl_add_head_rcu(struct hlist_bl_node *n,
+                                         struct hlist_bl_head *h)
+{
+    struct hlist_bl_node *first;
+
+    /* don't need hlist_bl_first_rcu because we're under lock */
+    first = hlist_bl_first(h);
+
+    n->next = first;
+    if (first)
+        first->pprev = &n->next;
+    n->pprev = &h->first;
+
+    /* need _rcu because we can have concurrent lock free readers */
+    hlist_bl_set_first_rcu(h, n);
+}
+
+/**
+ * hlist_bl_for_each_entry_rcu - iterate over rcu list of given type
+ * @tpos:	the type * to use as a loop cursor.
+ * @pos:	the &struct hlist_bl_node to use as a loop cursor.
+ * @head:	the head for your list.
+ * @member:	the name of the hlist_bl_node within the struct.
+ *
+ */
+#define hlist_bl_for_each_entry_rcu(tpos, pos, head, member)            \
+    for (pos = hlist_bl_first_rcu(head);                                \
+         pos &&                                                         \
+             ({ tpos = hlist_bl_entry(pos, __typeof__(*tpos), member); 1; }); \
+         pos = rcu_dereference(pos->next))
+
+#endif  /* __BR_RCULIST_BL_H */
@@ -0,0 +1,134 @@
+/* seqlock.h - sequence locks.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Sequence locks, after the kernel's <linux/seqlock.h>: writers serialize
+ * with a mutex, and increment a sequence counter before and after updates
+ * (the counter is odd during updates). Readers do not write shared memory:
+ * they read the counter, read the data, and retry if the counter changed.
+ *
+ *   do {
+ *       seq = read_seqbegin(&lock);
+ *       ... copy data ...
+ *   } while (read_seqretry(&lock, seq));
+ *
+ * Readers may see inconsistent data before retrying: they must not follow
+ * pointers which may be freed meanwhile (see rcu.h).
+ */
+
+#ifndef _SEQLOCK_H
+#define _SEQLOCK_H
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "brlib.h"
+#include "likely.h"
+
+typedef struct {
+    u32 seq;                                      /* odd during updates */
+    pthread_mutex_t lock;                         /* writers lock */
+} seqlock_t;
+
+#define SEQLOCK_INIT { .seq = 0, .lock = PTHREAD_MUTEX_INITIALIZER }
+
+/**
+ * seqlock_init - initialize a seqlock.
+ * @sl:    the seqlock.
+ *
+ * Return: 0, or an error number (see pthread_mutex_init(3)).
+ */
+static inline int seqlock_init(seqlock_t *sl)
+{
+    sl->seq = 0;
+    return pthread_mutex_init(&sl->lock, NULL);
+}
+
+static inline void seqlock_destroy(seqlock_t *sl)
+{
+    pthread_mutex_destroy(&sl->lock);
+}
+
+/**
+ * read_seqbegin - start a read-side critical section.
+ * @sl:    the seqlock.
+ *
+ * Wait while an update is in progress. As we may run on fewer CPUs than
+ * threads, yield after a few tries.
+ *
+ * Return: the sequence to give to read_seqretry().
+ */
+static inline u32 read_seqbegin(const seqlock_t *sl)
+{
+    u32 seq;
+    int spins = 0;
+
+    while (unlikely((seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE)) & 1))
+        if (++spins >= 64)
+            sched_yield();
+    return seq;
+}
+
+/**
+ * read_seqretry - end a read-side critical section.
+ * @sl:    the seqlock.
+ * @seq:   the value returned by read_seqbegin().
+ *
+ * Return: true if an update happened, and the read must be retried.
+ */
+static inline bool read_seqretry(const seqlock_t *sl, u32 seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return unlikely(__atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != seq);
+}
+
+/**
+ * read_seqlock_excl - start a locking read-side critical section.
+ * @sl:    the seqlock.
+ *
+ * Writers are excluded, but the sequence is unchanged: lockless readers do
+ * not retry.
+ */
+static inline void read_seqlock_excl(seqlock_t *sl)
+{
+    pthread_mutex_lock(&sl->lock);
+}
+
+/**
+ * read_sequnlock_excl - end a locking read-side critical section.
+ * @sl:    the seqlock.
+ */
+static inline void read_sequnlock_excl(seqlock_t *sl)
+{
+    pthread_mutex_unlock(&sl->lock);
+}
+
+/**
+ * write_seqlock - start a write-side critical section.
+ * @sl:    the seqlock.
+ */
+static inline void write_seqlock(seqlock_t *sl)
+{
+    pthread_mutex_lock(&sl->lock);
+    __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * write_sequnlock - end a write-side critical section.
+ * @sl:    the seqlock.
+ */
+static inline void write_sequnlock(seqlock_t *sl)
+{
+    __atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&sl->lock);
+}
+
+#endif  /* _SEQLOCK_H */
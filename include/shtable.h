@@ -0,0 +1,169 @@
+/* shtable.h - sharded concurrent hashtables.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Concurrent map of objects embedding a struct hlist_node, with u64 keys
+ * (given by a function passed to shtable_create()). Buckets are hlist heads,
+ * as in hashtable.h, partitioned in shards. Each shard has its own lock, in
+ * its own cache line: threads only contend when accessing the same shard.
+ * hash_64() of the key selects both the shard (high bits) and the bucket.
+ *
+ * Shard lock is either:
+ * - a pthread rwlock (default): readers take it shared.
+ * - a seqlock (SHTABLE_SEQLOCK): readers do not write shared memory. They
+ *   walk buckets within an RCU read-side critical section, and retry if a
+ *   writer modified the shard meanwhile. Objects removed with shtable_del()
+ *   must be freed after a grace period (see call_rcu()), and lookup functions
+ *   may be called more than once.
+ *
+ * Each shard maintains its objects count. Operations counters (lookups,
+ * hits, inserts, deletes) are maintained if compiled with -DSHTABLE_STATS:
+ * they are shared, and slow down readers.
+ */
+
+#ifndef _SHTABLE_H
+#define _SHTABLE_H
+
+#include <pthread.h>
+
+#include "brlib.h"
+#include "list.h"
+#include "seqlock.h"
+
+#define SHTABLE_SEQLOCK (1 << 0)                  /* seqlock instead of rwlock */
+#define SHTABLE_MAX_BITS 32                       /* hash_64() result is u32 */
+
+typedef struct shtable_stats {
+    u64 count;                                    /* objects */
+    u64 buckets;                                  /* buckets */
+    u64 used;                                     /* non-empty buckets */
+    u64 maxchain;                                 /* longest chain */
+    u64 lookups;                                  /* with SHTABLE_STATS */
+    u64 hits;
+    u64 inserts;
+    u64 deletes;
+} shtable_stats_t;
+
+struct shtable_shard {
+    union {
+        pthread_rwlock_t rwlock;
+        seqlock_t seqlock;
+    };
+    struct hlist_head *buckets;                   /* shard buckets */
+    u64 count;                                    /* objects in shard */
+#   ifdef SHTABLE_STATS
+    u64 lookups, hits, inserts, deletes;
+#   endif
+} __aligned(64);
+
+typedef struct shtable {
+    u32 flags;
+    u32 shardbits;                                /* log2(shards) */
+    u32 bucketbits;                               /* log2(buckets per shard) */
+    u64 (*key)(const struct hlist_node *node);    /* object key */
+    struct shtable_shard *shards;
+} shtable_t;
+
+/**
+ * shtable_create - create a sharded hashtable.
+ * @shardbits:  log2 of number of shards.
+ * @bucketbits: log2 of number of buckets per shard.
+ * @flags:      0 or SHTABLE_SEQLOCK.
+ * @key:        function returning an object key from its hlist_node.
+ *
+ * @shardbits + @bucketbits must be between 1 and SHTABLE_MAX_BITS, and each
+ * of them below 32.
+ *
+ * Return:      The table, or NULL if error (errno is set to EINVAL for bad
+ *              sizes, ENOMEM, or a lock initialization error).
+ */
+shtable_t *shtable_create(u32 shardbits, u32 bucketbits, u32 flags,
+                          u64 (*key)(const struct hlist_node *node));
+
+/**
+ * shtable_add - add an object, if its key is not present.
+ * @table:   the table.
+ * @node:    the &struct hlist_node of the object to add.
+ *
+ * Return:   NULL if object was added, or the object with the same key.
+ */
+struct hlist_node *shtable_add(shtable_t *table, struct hlist_node *node);
+
+/**
+ * shtable_del - remove an object.
+ * @table:   the table.
+ * @key:     the object key.
+ *
+ * With SHTABLE_SEQLOCK, the object may still be accessed by readers until
+ * a grace period has elapsed.
+ *
+ * Return:   The removed object, or NULL if not found.
+ */
+struct hlist_node *shtable_del(shtable_t *table, u64 key);
+
+/**
+ * shtable_lookup - find an object, and call a function on it.
+ * @table:   the table.
+ * @key:     the object key.
+ * @fn:      the function called with the object, or NULL.
+ * @arg:     @fn second argument.
+ *
+ * @fn is called with the shard read-locked: it should copy the data it needs,
+ * and must not modify the object. With SHTABLE_SEQLOCK, it may be called more
+ * than once, and must not trust the object contents (they may be modified
+ * concurrently), as they are only valid if not called again.
+ *
+ * Return:   true if object was found.
+ */
+bool shtable_lookup(shtable_t *table, u64 key,
+                    void (*fn)(struct hlist_node *node, void *arg), void *arg);
+
+/**
+ * shtable_update - find an object, and call a function to modify it.
+ * @table:   the table.
+ * @key:     the object key.
+ * @fn:      the function called with the object.
+ * @arg:     @fn second argument.
+ *
+ * @fn is called with the shard write-locked. It must not change the object key.
+ *
+ * Return:   true if object was found.
+ */
+bool shtable_update(shtable_t *table, u64 key,
+                    void (*fn)(struct hlist_node *node, void *arg), void *arg);
+
+/**
+ * shtable_shard_stats - get a shard statistics.
+ * @table:   the table.
+ * @shard:   the shard number.
+ * @stats:   the statistics to fill.
+ *
+ * Chains lengths are computed with the shard read-locked.
+ */
+void shtable_shard_stats(shtable_t *table, u32 shard, shtable_stats_t *stats);
+
+/**
+ * shtable_stats - log table statistics.
+ * @table:   the table.
+ *
+ * Log totals, and each shard occupancy and chains statistics.
+ */
+void shtable_stats(shtable_t *table);
+
+/**
+ * shtable_destroy - destroy a table.
+ * @table:   the table.
+ * @fn:      function called on each remaining object, or NULL.
+ *
+ * The table must not be in use.
+ */
+void shtable_destroy(shtable_t *table, void (*fn)(struct hlist_node *node));
+
+#endif  /* _SHTABLE_H */
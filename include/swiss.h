@@ -0,0 +1,134 @@
+/* swiss.h - open-addressing SIMD hashtables.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * A "Swiss table": flat open-addressing hashtable storing fixed-size keys and
+ * values in a slots array, with one control byte per slot:
+ *   - empty:   0x80.
+ *   - deleted: 0xfe.
+ *   - full:    0x00-0x7f, the 7 lowest bits of the key hash.
+ * Slots are grouped by SWISS_GROUP (16 with SSE2, 32 with AVX2). A lookup
+ * hashes the key to a group, and compares the 7 hash bits with all the group
+ * control bytes with one SIMD instruction: only slots with a matching
+ * control byte are compared. Following groups are probed (quadratically)
+ * until the key is found, or a group with an empty slot is reached.
+ *
+ * Compared to hashtable.h chained tables, there is no pointer chasing, and
+ * most lookups touch one control group and one slot. Keys and values are
+ * copied into the table: pointers to them are only valid until next
+ * insertion (which may resize the table).
+ *
+ * Tables are not thread-safe.
+ */
+
+#ifndef _SWISS_H
+#define _SWISS_H
+
+#include <stddef.h>
+
+#include "brlib.h"
+
+#if defined(__AVX2__)
+#  define SWISS_GROUP 32
+#else
+#  define SWISS_GROUP 16
+#endif
+
+#define SWISS_EMPTY   ((s8) 0x80)
+#define SWISS_DELETED ((s8) 0xfe)
+
+typedef struct swiss {
+    s8 *ctrl;                                     /* control bytes */
+    char *slots;                                  /* key/value slots */
+    size_t keysize;                               /* key size */
+    size_t valsize;                               /* value size */
+    size_t valoff;                                /* value offset in slot */
+    size_t slotsize;                              /* slot size */
+    u64 groupmask;                                /* groups - 1 */
+    u64 capacity;                                 /* slots */
+    u64 count;                                    /* keys in table */
+    u64 growth;                                   /* insertions left before resize */
+    u64 (*hash)(const void *key, size_t size);    /* key hash */
+    bool (*eq)(const void *k1, const void *k2, size_t size); /* key equality */
+} swiss_t;
+
+/**
+ * swiss_create - create a Swiss table.
+ * @keysize: key size.
+ * @valsize: value size (may be 0, for a set).
+ * @hint:    expected number of keys, or 0.
+ * @hash:    key hash function, or NULL for default byte hash.
+ * @eq:      key equality function, or NULL for memcmp().
+ *
+ * The default hash is fast for 8 bytes keys.
+ *
+ * Return:   The table, or NULL if error (errno is set to ENOMEM).
+ */
+swiss_t *swiss_create(size_t keysize, size_t valsize, u64 hint,
+                      u64 (*hash)(const void *key, size_t size),
+                      bool (*eq)(const void *k1, const void *k2, size_t size));
+
+/**
+ * swiss_get - find a key.
+ * @table:   the table.
+ * @key:     the key.
+ *
+ * Return:   The key value address, or NULL if not found.
+ */
+void *swiss_get(swiss_t *table, const void *key);
+
+/**
+ * swiss_put - insert or replace a key.
+ * @table:   the table.
+ * @key:     the key.
+ * @val:     the value to copy, or NULL.
+ *
+ * If @val is NULL, the value is left uninitialized (new key) or unchanged
+ * (existing key): it may be set with the returned address.
+ *
+ * Return:   The key value address, or NULL if error (errno is set to ENOMEM).
+ */
+void *swiss_put(swiss_t *table, const void *key, const void *val);
+
+/**
+ * swiss_del - delete a key.
+ * @table:   the table.
+ * @key:     the key.
+ *
+ * Return:   true if key was found and deleted.
+ */
+bool swiss_del(swiss_t *table, const void *key);
+
+/**
+ * swiss_next - iterate over a table.
+ * @table:   the table.
+ * @pos:     u64 iteration cursor, to be initialized to 0.
+ * @key:     address of key pointer to set, or NULL.
+ *
+ * Return:   The next key value address, or NULL at table end.
+ */
+void *swiss_next(swiss_t *table, u64 *pos, void **key);
+
+/**
+ * swiss_count - number of keys in table.
+ * @table:   the table.
+ */
+static inline u64 swiss_count(const swiss_t *table)
+{
+    return table->count;
+}
+
+/**
+ * swiss_destroy - destroy a table.
+ * @table:   the table.
+ */
+void swiss_destroy(swiss_t *table);
+
+#endif  /* _SWISS_H */
@@ -0,0 +1,176 @@
+/* ulist.h - unrolled (chunked) lists.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * An unrolled list stores its elements inline, by chunks of several elements
+ * per node. Nodes are doubly-linked with a struct list_head.
+ * Compared to list_head lists, traversal touches a few cache lines per node
+ * instead of one (random) cache line per element, and the next node is
+ * prefetched while the current one is walked.
+ * Elements have a fixed size, given at initialization. To keep a list of
+ * objects, use pointers as elements.
+ */
+
+#ifndef _ULIST_H
+#define _ULIST_H
+
+#include <stddef.h>
+
+#include "brlib.h"
+#include "list.h"
+
+#define ULIST_NODE_SIZE (256)                     /* node size, including header */
+
+struct ulist_node {
+    struct list_head list;                        /* nodes list */
+    u32 count;                                    /* elements in node */
+    char data[] __aligned(8);                     /* elements */
+};
+
+struct ulist_head {
+    struct list_head nodes;                       /* nodes list */
+    size_t objsize;                               /* element size */
+    size_t eltsize;                               /* element stride in nodes */
+    u32 pernode;                                  /* max elements per node */
+    u32 count;                                    /* total elements */
+};
+
+/* iteration cursor, see ulist_for_each()
+ */
+struct ulist_iter {
+    struct ulist_head *head;                      /* list */
+    struct ulist_node *node;                      /* current node */
+    u32 idx;                                      /* current element index in node */
+    u32 count;                                    /* current node elements */
+};
+
+/**
+ * ulist_init - initialize an unrolled list.
+ * @head:    the list.
+ * @eltsize: the elements size.
+ *
+ * Elements are aligned on 8 bytes. If @eltsize is too large for
+ * ULIST_NODE_SIZE nodes, nodes hold one element.
+ */
+void ulist_init(struct ulist_head *head, size_t eltsize);
+
+/**
+ * ulist_add - add an element at list start.
+ * @head:    the list.
+ * @elt:     the element to copy, or NULL.
+ *
+ * Return:   The address of the new element in list (to be filled if @elt is
+ *           NULL), or NULL if error.
+ */
+void *ulist_add(struct ulist_head *head, const void *elt);
+
+/**
+ * ulist_add_tail - add an element at list end.
+ * @head:    the list.
+ * @elt:     the element to copy, or NULL.
+ *
+ * Return:   The address of the new element in list (to be filled if @elt is
+ *           NULL), or NULL if error.
+ */
+void *ulist_add_tail(struct ulist_head *head, const void *elt);
+
+/**
+ * ulist_del - delete current element of an iteration.
+ * @iter:    the iteration cursor.
+ *
+ * The following elements in node are moved, and the node is freed if it
+ * becomes empty. The cursor is adjusted so that next ulist_next() returns
+ * the element following the deleted one: it is safe to delete elements in
+ * ulist_for_each() loop.
+ * Attention: elements addresses in the same node change.
+ */
+void ulist_del(struct ulist_iter *iter);
+
+/**
+ * ulist_free - delete all elements of a list.
+ * @head:    the list.
+ */
+void ulist_free(struct ulist_head *head);
+
+/**
+ * ulist_empty - test whether a list is empty.
+ * @head:    the list.
+ */
+static inline int ulist_empty(const struct ulist_head *head)
+{
+    return !head->count;
+}
+
+static inline void *__ulist_elt(struct ulist_head *head, struct ulist_node *node,
+                                u32 idx)
+{
+    return node->data + idx * head->eltsize;
+}
+
+/* start walking a node: its successor is prefetched.
+ */
+static inline void *__ulist_enter(struct ulist_iter *iter, struct list_head *list)
+{
+    if (list == &iter->head->nodes)
+        return NULL;
+    iter->node = list_entry(list, struct ulist_node, list);
+    iter->idx = 0;
+    iter->count = iter->node->count;
+    prefetch(iter->node->list.next);
+    return __ulist_elt(iter->head, iter->node, 0);
+}
+
+/**
+ * ulist_first - start an iteration.
+ * @iter:    the iteration cursor.
+ * @head:    the list.
+ *
+ * Return:   The first element address, or NULL if list is empty.
+ */
+static inline void *ulist_first(struct ulist_iter *iter, struct ulist_head *head)
+{
+    iter->head = head;
+    return __ulist_enter(iter, head->nodes.next);
+}
+
+/**
+ * ulist_next - get next element of an iteration.
+ * @iter:    the iteration cursor.
+ *
+ * Return:   The next element address, or NULL at list end.
+ */
+static inline void *ulist_next(struct ulist_iter *iter)
+{
+    if (++iter->idx < iter->count)
+        return __ulist_elt(iter->head, iter->node, iter->idx);
+    return __ulist_enter(iter, iter->node->list.next);
+}
+
+/**
+ * ulist_for_each - iterate over an unrolled list.
+ * @pos:     the element pointer to use as a loop cursor.
+ * @iter:    the struct ulist_iter to use as iteration cursor.
+ * @head:    the list.
+ */
+#define ulist_for_each(pos, iter, head)                               \
+    for (pos = ulist_first(iter, head); pos; pos = ulist_next(iter))
+
+/**
+ * ulist_for_each_node - iterate over an unrolled list nodes.
+ * @node:    the struct ulist_node to use as a loop cursor.
+ * @head:    the list.
+ *
+ * This allows to walk elements by chunks: @node->count elements, starting
+ * at @node->data.
+ */
+#define ulist_for_each_node(node, head)                               \
+    list_for_each_entry(node, &(head)->nodes, list)
+
+#endif  /* _ULIST_H */
@@ -0,0 +1,192 @@
+/* arena.c - A simple arena (region) memory allocator.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "brlib.h"
+#include "likely.h"
+#include "list.h"
+#include "arena.h"
+#include "debug.h"
+
+void arena_stats(arena_t *arena)
+{
+    if (arena) {
+        arena_block_t *block;
+
+        log_f(1, "[%s] arena [%p]: blocks:%u used:%zu blocksize:%zu\n",
+              arena->name, (void *)arena, arena->nblocks, arena_used(arena),
+              arena->blocksize);
+        log(5, "\tblocks: ");
+        list_for_each_entry(block, &arena->list_blocks, list_blocks) {
+            log(5, "%p ", block);
+        }
+        log(5, "\n");
+    }
+}
+
+arena_t *arena_create(const char *name, size_t size)
+{
+    arena_t *arena;
+
+#   ifdef DEBUG_ARENA
+    log_f(1, "name=[%s] size=%zu\n", name, size);
+#   endif
+    if ((arena = malloc(sizeof(*arena)))) {
+        strncpy(arena->name, name, ARENA_NAME_LENGTH - 1);
+        arena->name[ARENA_NAME_LENGTH - 1] = 0;
+        arena->blocksize = size;
+        arena->nblocks = 0;
+        arena->used = 0;
+        arena->cur = NULL;
+        arena->block = NULL;
+        INIT_LIST_HEAD(&arena->list_blocks);
+    } else {
+        errno = ENOMEM;
+    }
+    return arena;
+}
+
+/* add a new block, large enough for @size bytes aligned on @align, and
+ * allocate from it. Free space left in current block is lost.
+ */
+static void *_arena_grow(arena_t *arena, size_t size, size_t align)
+{
+    size_t datasize;
+    arena_block_t *block;
+    char *ptr;
+
+    if (align - 1 > SIZE_MAX - sizeof(*block) ||
+        size > SIZE_MAX - sizeof(*block) - (align - 1)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    datasize = max(arena->blocksize, size + align - 1);
+    if (!(block = malloc(sizeof(*block) + datasize))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+#   ifdef DEBUG_ARENA
+    log_f(1, "[%s]: new block=%p size=%zu nblocks=%u\n", arena->name,
+          (void *)block, datasize, arena->nblocks + 1);
+#   endif
+    if (arena->block)
+        arena->used += arena->cur - arena->block->data;
+    block->end = block->data + datasize;
+    list_add_tail(&block->list_blocks, &arena->list_blocks);
+    arena->nblocks++;
+    arena->block = block;
+    ptr = (char *)ALIGN((uintptr_t)block->data, align);
+    arena->cur = ptr + size;
+    return ptr;
+}
+
+void *arena_alloc_align(arena_t *arena, size_t size, size_t align)
+{
+    if (likely(arena->block)) {
+        char *ptr = (char *)ALIGN((uintptr_t)arena->cur, align);
+
+        if (likely(ptr <= arena->block->end &&
+                   size <= (size_t)(arena->block->end - ptr))) {
+            arena->cur = ptr + size;
+            return ptr;
+        }
+    }
+    return _arena_grow(arena, size, align);
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    return arena_alloc_align(arena, size, __alignof__(max_align_t));
+}
+
+arena_mark_t arena_mark(arena_t *arena)
+{
+    return (arena_mark_t) {
+        .block = arena->block,
+        .cur = arena->cur,
+        .used = arena->used
+    };
+}
+
+/* free all blocks after @block.
+ */
+static void _arena_free_after(arena_t *arena, arena_block_t *block)
+{
+    arena_block_t *last;
+
+    while ((last = list_last_entry(&arena->list_blocks, arena_block_t,
+                                   list_blocks)) != block) {
+        list_del(&last->list_blocks);
+        free(last);
+        arena->nblocks--;
+    }
+}
+
+void arena_rewind(arena_t *arena, arena_mark_t mark)
+{
+    if (!mark.block) {
+        arena_reset(arena);
+        return;
+    }
+#   ifdef DEBUG_ARENA
+    log_f(2, "[%s]: rewind to block=%p cur=%p\n", arena->name,
+          (void *)mark.block, (void *)mark.cur);
+#   endif
+    _arena_free_after(arena, mark.block);
+    arena->block = mark.block;
+    arena->cur = mark.cur;
+    arena->used = mark.used;
+}
+
+void arena_reset(arena_t *arena)
+{
+    arena_block_t *first;
+
+    if (!arena->block)
+        return;
+#   ifdef DEBUG_ARENA
+    log_f(2, "[%s]: reset, releasing %u blocks\n", arena->name, arena->nblocks - 1);
+#   endif
+    first = list_first_entry(&arena->list_blocks, arena_block_t, list_blocks);
+    _arena_free_after(arena, first);
+    arena->block = first;
+    arena->cur = first->data;
+    arena->used = 0;
+}
+
+size_t arena_used(arena_t *arena)
+{
+    return arena->block? arena->used + (arena->cur - arena->block->data): 0;
+}
+
+void arena_destroy(arena_t *arena)
+{
+    arena_block_t *block, *tmp;
+
+    if (!arena)
+        return;
+#   ifdef DEBUG_ARENA
+    log_f(1, "[%s]: releasing %u blocks and main structure\n", arena->name,
+          arena->nblocks);
+#   endif
+    list_for_each_entry_safe(block, tmp, &arena->list_blocks, list_blocks) {
+        list_del(&block->list_blocks);
+        free(block);
+    }
+    free(arena);
+}
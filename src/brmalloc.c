@@ -0,0 +1,187 @@
+/* brmalloc.c - A small objects allocator, based on pools.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "brlib.h"
+#include "likely.h"
+#include "pool.h"
+#include "brmalloc.h"
+#include "bug.h"
+#include "debug.h"
+
+/* All size classes pools are POOL_RECLAIM ones, with BRMALLOC_BLOCK_SIZE
+ * blocks, aligned on their size: the owner pool of any object is found in
+ * its block header.
+ * Large objects are allocated with malloc(3), after a 16 bytes header.
+ * A block owns its whole BRMALLOC_BLOCK_SIZE aligned area: an area where a
+ * large object starts cannot be a block. br_free() looks up the number of
+ * large objects starting in the object area, in a two levels map indexed by
+ * the area number (address >> BRMALLOC_BLOCK_SHIFT), whose leaves are
+ * allocated on demand and never freed. User data is never read.
+ * As large objects are larger than BRMALLOC_MAX_SIZE, an area count fits in
+ * a u8.
+ */
+#define BRMALLOC_BLOCK_SHIFT 18
+#define LARGE_ADDR_BITS      48                   /* user space addresses */
+#define LARGE_LEAF_BITS      18                   /* areas per leaf (log2) */
+#define LARGE_TOP_BITS       (LARGE_ADDR_BITS - BRMALLOC_BLOCK_SHIFT - LARGE_LEAF_BITS)
+
+_Static_assert(BRMALLOC_BLOCK_SIZE == 1UL << BRMALLOC_BLOCK_SHIFT,
+               "BRMALLOC_BLOCK_SHIFT mismatch");
+_Static_assert(BRMALLOC_BLOCK_SIZE / (BRMALLOC_MAX_SIZE + 1) < 256,
+               "large objects area count must fit in a u8");
+
+struct large_hdr {
+    size_t size;                                  /* requested size */
+    size_t pad;                                   /* keep objects 16-bytes aligned */
+};
+
+static pool_t *classes[BRMALLOC_NCLASSES];
+static pthread_once_t classes_once = PTHREAD_ONCE_INIT;
+
+static u8 *large_map[1UL << LARGE_TOP_BITS];     /* large objects per area */
+static pthread_mutex_t large_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline block_t *block_of(void *ptr)
+{
+    return (block_t *)((uintptr_t)ptr & ~(BRMALLOC_BLOCK_SIZE - 1));
+}
+
+/* @ptr area count address, or NULL if its leaf does not exist.
+ */
+static inline u8 *large_count(void *ptr)
+{
+    uintptr_t area = (uintptr_t)ptr >> BRMALLOC_BLOCK_SHIFT;
+    u8 *leaf;
+
+    if (unlikely(area >> (LARGE_TOP_BITS + LARGE_LEAF_BITS)))
+        return NULL;
+    leaf = __atomic_load_n(large_map + (area >> LARGE_LEAF_BITS), __ATOMIC_ACQUIRE);
+    return leaf? leaf + (area & ((1UL << LARGE_LEAF_BITS) - 1)): NULL;
+}
+
+static inline bool is_large(void *ptr)
+{
+    u8 *count = large_count(ptr);
+
+    return count && __atomic_load_n(count, __ATOMIC_RELAXED);
+}
+
+/* allocate @ptr leaf if needed.
+ * Return: the @ptr area count address, or NULL if error.
+ */
+static u8 *large_count_alloc(void *ptr)
+{
+    uintptr_t area = (uintptr_t)ptr >> BRMALLOC_BLOCK_SHIFT;
+    u8 **leaf = large_map + (area >> LARGE_LEAF_BITS);
+    u8 *count;
+
+    if ((count = large_count(ptr)))
+        return count;
+    if (area >> (LARGE_TOP_BITS + LARGE_LEAF_BITS))
+        return NULL;
+    pthread_mutex_lock(&large_lock);
+    if (!*leaf)
+        __atomic_store_n(leaf, calloc(1UL << LARGE_LEAF_BITS, 1), __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&large_lock);
+    return large_count(ptr);
+}
+
+static void classes_init(void)
+{
+    pool_attr_t attr = {
+        .flags = POOL_MT | POOL_SLIST | POOL_RECLAIM,
+        .blocksize = BRMALLOC_BLOCK_SIZE,
+    };
+
+    for (uint i = 0; i < BRMALLOC_NCLASSES; ++i) {
+        size_t size = brmalloc_class_size(i);
+        char name[POOL_NAME_LENGTH];
+
+        snprintf(name, sizeof(name), "brmalloc-%zu", size);
+        attr.align = size > 64? 16: 8;
+        classes[i] = pool_create_attr(name, 0, size, &attr);
+        /* block_of() masks with BRMALLOC_BLOCK_SIZE */
+        bug_on_always(classes[i] && classes[i]->blocksize != BRMALLOC_BLOCK_SIZE);
+#       ifdef DEBUG_POOL
+        log_f(2, "class %u: size=%zu pool=%p\n", i, size, (void *)classes[i]);
+#       endif
+    }
+}
+
+static void *large_malloc(size_t size)
+{
+    struct large_hdr *hdr;
+    u8 *count;
+
+    if (size > SIZE_MAX - sizeof(*hdr) || !(hdr = malloc(sizeof(*hdr) + size)))
+        goto err;
+    if (!(count = large_count_alloc(hdr + 1))) {
+        free(hdr);
+        goto err;
+    }
+    __atomic_add_fetch(count, 1, __ATOMIC_RELAXED);
+    hdr->size = size;
+    return hdr + 1;
+err:
+    errno = ENOMEM;
+    return NULL;
+}
+
+void *br_malloc(size_t size)
+{
+    pool_t *pool;
+
+    if (unlikely(size > BRMALLOC_MAX_SIZE))
+        return large_malloc(size);
+    pthread_once(&classes_once, classes_init);
+    if (unlikely(!(pool = classes[brmalloc_class(size)]))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return pool_get(pool);
+}
+
+void br_free(void *ptr)
+{
+    block_t *block;
+
+    if (!ptr)
+        return;
+    if (unlikely(is_large(ptr))) {
+        __atomic_sub_fetch(large_count(ptr), 1, __ATOMIC_RELAXED);
+        free((struct large_hdr *)ptr - 1);
+    } else {
+        block = block_of(ptr);
+        bug_on(block->pool != classes[brmalloc_class(block->pool->objsize)]);
+        pool_add(block->pool, ptr);
+    }
+}
+
+size_t br_usable_size(void *ptr)
+{
+    if (is_large(ptr))
+        return ((struct large_hdr *)ptr - 1)->size;
+    return block_of(ptr)->pool->objsize;
+}
+
+void br_malloc_stats(void)
+{
+    for (uint i = 0; i < BRMALLOC_NCLASSES; ++i)
+        if (classes[i] && classes[i]->nblocks)
+            pool_stats(classes[i]);
+}
@@ -0,0 +1,302 @@
+/* cuckoo.c - bucketized cuckoo hashtables.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "brlib.h"
+#include "bitops.h"
+#include "hash.h"
+#include "likely.h"
+#include "debug.h"
+#include "cuckoo.h"
+
+/* second hash multiplier: any odd constant unrelated to GOLDEN_RATIO_64 */
+#define CUCKOO_MUL 0xC2B2AE3D27D4EB4FULL
+
+/* initial table load when a size hint is given: 90% */
+#define HINT_LOAD(capacity) ((capacity) - (capacity) / 10)
+
+static inline u32 _hash1(const cuckoo_t *t, u64 key)
+{
+    return hash_64(key ^ t->seed, t->bits);
+}
+
+/* second bucket is always different from first one.
+ */
+static inline u32 _hash2(const cuckoo_t *t, u64 key, u32 h1)
+{
+    u64 k = key ^ t->seed;
+    u32 h2 = ror64(k, 32) * CUCKOO_MUL >> (64 - t->bits);
+
+    return h2 != h1? h2: h1 ^ 1;
+}
+
+/* xorshift64*, for kick victims and seeds.
+ */
+static inline u64 _rand(cuckoo_t *t)
+{
+    u64 x = t->rand;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    t->rand = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static inline int _find_slot(const struct cuckoo_bucket *b, u64 key)
+{
+    for (int i = 0; i < CUCKOO_SLOTS; ++i)
+        if (b->keys[i] == key)
+            return i;
+    return -1;
+}
+
+static struct cuckoo_bucket *_alloc(u32 bits)
+{
+    size_t size = sizeof(struct cuckoo_bucket) << bits;
+    void *mem;
+
+    if (posix_memalign(&mem, 64, size)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(mem, 0xff, size);                      /* all keys are CUCKOO_EMPTY */
+    return mem;
+}
+
+/* place @key/@val in a free slot of its buckets, moving other keys if needed.
+ * If no place is found after CUCKOO_MAX_KICKS moves, these moves are undone.
+ * Return: 0 on success, -1 if table must be rebuilt.
+ */
+static int _place(cuckoo_t *t, u64 key, u64 val)
+{
+    u32 path[CUCKOO_MAX_KICKS];
+    u8 slots[CUCKOO_MAX_KICKS];
+    u32 b = _hash1(t, key), h1;
+    int i, kicks;
+
+    if ((i = _find_slot(t->buckets + b, CUCKOO_EMPTY)) >= 0)
+        goto place;
+    b = _hash2(t, key, b);
+    if ((i = _find_slot(t->buckets + b, CUCKOO_EMPTY)) >= 0)
+        goto place;
+
+    /* @key/@val becomes the moved entry, @b its current bucket */
+    for (kicks = 0; kicks < CUCKOO_MAX_KICKS; ++kicks) {
+        struct cuckoo_bucket *bucket = t->buckets + b;
+
+        i = _rand(t) % CUCKOO_SLOTS;
+        path[kicks] = b;
+        slots[kicks] = i;
+        swap(key, bucket->keys[i]);
+        swap(val, bucket->vals[i]);
+        h1 = _hash1(t, key);
+        b = h1 != b? h1: _hash2(t, key, h1);
+        if ((i = _find_slot(t->buckets + b, CUCKOO_EMPTY)) >= 0) {
+            t->kicks += kicks + 1;
+            t->maxkicks = max(t->maxkicks, (u64) kicks + 1);
+            goto place;
+        }
+    }
+    while (kicks--) {
+        struct cuckoo_bucket *bucket = t->buckets + path[kicks];
+
+        swap(key, bucket->keys[slots[kicks]]);
+        swap(val, bucket->vals[slots[kicks]]);
+    }
+    return -1;
+
+place:
+    t->buckets[b].keys[i] = key;
+    t->buckets[b].vals[i] = val;
+    return 0;
+}
+
+/* rebuild table with (1 << @bits) buckets and a new seed, and add @key/@val.
+ * If it fails, the table size is doubled and we try again.
+ * Return: 0 on success, -1 on error (table is unchanged).
+ */
+static int _rebuild(cuckoo_t *t, u32 bits, u64 key, u64 val)
+{
+    struct cuckoo_bucket *old = t->buckets;
+    u32 oldbits = t->bits;
+    u64 oldseed = t->seed;
+
+    if (bits == oldbits)
+        t->reseeds++;
+again:
+    if (bits != oldbits)
+        t->grows++;
+    if (!(t->buckets = _alloc(bits))) {
+        t->buckets = old;
+        t->bits = oldbits;
+        t->seed = oldseed;
+        return -1;
+    }
+    t->bits = bits;
+    t->seed = _rand(t);
+    for (u64 b = 0; b < 1UL << oldbits; ++b) {
+        for (int i = 0; i < CUCKOO_SLOTS; ++i) {
+            if (old[b].keys[i] != CUCKOO_EMPTY &&
+                _place(t, old[b].keys[i], old[b].vals[i]))
+                goto fail;
+        }
+    }
+    if (_place(t, key, val))
+        goto fail;
+    free(old);
+    return 0;
+
+fail:
+    free(t->buckets);
+    bits++;
+    goto again;
+}
+
+cuckoo_t *cuckoo_create(u64 hint)
+{
+    cuckoo_t *t;
+    u32 bits = CUCKOO_MIN_BITS;
+
+    while (HINT_LOAD((u64) CUCKOO_SLOTS << bits) < hint)
+        bits++;
+    if (!(t = malloc(sizeof(*t)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    *t = (cuckoo_t) {
+        .bits = bits,
+        .rand = 0x9E3779B97F4A7C15ULL ^ (uintptr_t) t,
+    };
+    if (!(t->buckets = _alloc(bits))) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+/* find @key (not CUCKOO_EMPTY) bucket and slot.
+ * Return: the slot, or -1 if not found.
+ */
+static inline int _find(const cuckoo_t *t, u64 key, struct cuckoo_bucket **bucket)
+{
+    u32 h1 = _hash1(t, key);
+    struct cuckoo_bucket *b1 = t->buckets + h1;
+    struct cuckoo_bucket *b2 = t->buckets + _hash2(t, key, h1);
+    int i;
+
+    __builtin_prefetch(b2);
+    if ((i = _find_slot(b1, key)) >= 0) {
+        *bucket = b1;
+        return i;
+    }
+    *bucket = b2;
+    return _find_slot(b2, key);
+}
+
+u64 *cuckoo_get(cuckoo_t *t, u64 key)
+{
+    struct cuckoo_bucket *b;
+    int i;
+
+    if (unlikely(key == CUCKOO_EMPTY))
+        return t->has_empty? &t->empty_val: NULL;
+    i = _find(t, key, &b);
+    return i < 0? NULL: b->vals + i;
+}
+
+int cuckoo_put(cuckoo_t *t, u64 key, u64 val)
+{
+    u64 *slot;
+
+    if (unlikely(key == CUCKOO_EMPTY)) {
+        if (!t->has_empty)
+            t->count++;
+        t->has_empty = true;
+        t->empty_val = val;
+        return 0;
+    }
+    if ((slot = cuckoo_get(t, key))) {
+        *slot = val;
+        return 0;
+    }
+    if (unlikely(_place(t, key, val))) {
+        u32 bits = t->count * 100 < cuckoo_capacity(t) * CUCKOO_MIN_LOAD?
+            t->bits: t->bits + 1;
+
+        if (_rebuild(t, bits, key, val))
+            return -1;
+    }
+    t->count++;
+    return 0;
+}
+
+bool cuckoo_del(cuckoo_t *t, u64 key)
+{
+    struct cuckoo_bucket *b;
+    int i;
+
+    if (unlikely(key == CUCKOO_EMPTY)) {
+        if (!t->has_empty)
+            return false;
+        t->has_empty = false;
+    } else {
+        if ((i = _find(t, key, &b)) < 0)
+            return false;
+        b->keys[i] = CUCKOO_EMPTY;
+    }
+    t->count--;
+    return true;
+}
+
+u64 *cuckoo_next(cuckoo_t *t, u64 *pos, u64 *key)
+{
+    u64 capacity = cuckoo_capacity(t);
+
+    for (; *pos < capacity; ++*pos) {
+        struct cuckoo_bucket *b = t->buckets + *pos / CUCKOO_SLOTS;
+        int i = *pos % CUCKOO_SLOTS;
+
+        if (b->keys[i] != CUCKOO_EMPTY) {
+            ++*pos;
+            if (key)
+                *key = b->keys[i];
+            return b->vals + i;
+        }
+    }
+    if (*pos == capacity && t->has_empty) {
+        ++*pos;
+        if (key)
+            *key = CUCKOO_EMPTY;
+        return &t->empty_val;
+    }
+    return NULL;
+}
+
+void cuckoo_stats(cuckoo_t *t)
+{
+    log_f(1, "cuckoo [%p]: buckets:%llu slots:%d count:%llu load:%.1f%% "
+          "kicks:%llu maxkicks:%llu grows:%llu reseeds:%llu\n",
+          (void *)t, 1ULL << t->bits, CUCKOO_SLOTS, (ullong) t->count,
+          t->count * 100.0 / cuckoo_capacity(t), (ullong) t->kicks,
+          (ullong) t->maxkicks, (ullong) t->grows, (ullong) t->reseeds);
+}
+
+void cuckoo_destroy(cuckoo_t *t)
+{
+    free(t->buckets);
+    free(t);
+}
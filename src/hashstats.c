@@ -0,0 +1,62 @@
+/* hashstats.c - hashtables chain-length diagnostics.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#include "brlib.h"
+#include "list.h"
+#include "list_bl.h"
+#include "rcu.h"
+#include "rculist.h"
+#include "rculist_bl.h"
+#include "debug.h"
+#include "hashstats.h"
+
+void hash_stats_hlist(hash_stats_t *stats, struct hlist_head *ht, u64 sz)
+{
+    for (u64 i = 0; i < sz; ++i) {
+        struct hlist_node *node = rcu_dereference(hlist_first_rcu(ht + i));
+        u64 len = 0;
+
+        for (; node; node = rcu_dereference(hlist_next_rcu(node)))
+            len++;
+        hash_stats_chain(stats, len);
+    }
+}
+
+void hash_stats_hlist_bl(hash_stats_t *stats, struct hlist_bl_head *ht, u64 sz)
+{
+    for (u64 i = 0; i < sz; ++i) {
+        struct hlist_bl_node *node = hlist_bl_first_rcu(ht + i);
+        u64 len = 0;
+
+        for (; node; node = rcu_dereference(node->next))
+            len++;
+        hash_stats_chain(stats, len);
+    }
+}
+
+void hash_stats_log(const char *name, const hash_stats_t *stats)
+{
+    log_f(1, "[%s] buckets:%llu entries:%llu load:%.2f empty:%.1f%% "
+          "chain mean:%.2f max:%llu probes hit:%.3f (ideal:%.3f) miss:%.3f\n",
+          name, (ullong) stats->buckets, (ullong) stats->entries,
+          hash_stats_miss_cost(stats), hash_stats_empty(stats) * 100.0,
+          hash_stats_mean(stats), (ullong) stats->maxchain,
+          hash_stats_hit_cost(stats), hash_stats_ideal_cost(stats),
+          hash_stats_miss_cost(stats));
+    log_f(2, "[%s] histogram:", name);
+    for (int i = 0; i < HASH_STATS_HIST; ++i)
+        if (stats->hist[i])
+            log(2, " %d%s:%llu", i, i == HASH_STATS_HIST - 1? "+": "",
+                (ullong) stats->hist[i]);
+    log(2, "\n");
+}
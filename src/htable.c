@@ -0,0 +1,126 @@
+/* htable.c - dynamically resizable hashtables.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "brlib.h"
+#include "list.h"
+#include "hash.h"
+#include "hashstats.h"
+#include "htable.h"
+
+int htable_init(htable_t *ht, u32 bits, u64 (*key)(const struct hlist_node *node))
+{
+    bits = clamp(bits, (u32) HTABLE_MIN_BITS, (u32) HTABLE_MAX_BITS);
+    if (!(ht->buckets = calloc(1UL << bits, sizeof(struct hlist_head)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    ht->old = NULL;
+    ht->bits = ht->minbits = bits;
+    ht->oldbits = ht->rehash = 0;
+    ht->count = 0;
+    ht->key = key;
+    return 0;
+}
+
+void htable_free(htable_t *ht)
+{
+    free(ht->buckets);
+    free(ht->old);
+    ht->buckets = ht->old = NULL;
+    ht->count = 0;
+}
+
+/* move up to @n old buckets to current buckets.
+ */
+static void _rehash_step(htable_t *ht, u32 n)
+{
+    u32 oldsize = 1U << ht->oldbits;
+    struct hlist_node *node, *tmp;
+
+    for (; n && ht->rehash < oldsize; --n, ++ht->rehash) {
+        struct hlist_head *old = ht->old + ht->rehash;
+
+        hlist_for_each_safe(node, tmp, old) {
+            __hlist_del(node);
+            hlist_add_head(node, ht->buckets + hash_64(ht->key(node), ht->bits));
+        }
+        INIT_HLIST_HEAD(old);
+    }
+    if (ht->rehash == oldsize) {
+        free(ht->old);
+        ht->old = NULL;
+    }
+}
+
+/* rehash step for htable_add() and htable_del(). When shrinking, old buckets
+ * load is below 1/HTABLE_MIN_LOAD_DIV: more (mostly empty) buckets are moved,
+ * so that the rehash completes before the table can shrink again.
+ */
+static inline void _rehash_some(htable_t *ht)
+{
+    _rehash_step(ht, ht->oldbits > ht->bits?
+                 HTABLE_REHASH_STEP * HTABLE_MIN_LOAD_DIV: HTABLE_REHASH_STEP);
+}
+
+void htable_rehash(htable_t *ht)
+{
+    if (ht->old)
+        _rehash_step(ht, 1U << ht->oldbits);
+}
+
+/* start resizing to (1 << @bits) buckets. Must not be called during a
+ * rehash.
+ */
+static void _resize(htable_t *ht, u32 bits)
+{
+    struct hlist_head *buckets;
+
+    if (!(buckets = calloc(1UL << bits, sizeof(struct hlist_head))))
+        return;
+    ht->old = ht->buckets;
+    ht->oldbits = ht->bits;
+    ht->rehash = 0;
+    ht->buckets = buckets;
+    ht->bits = bits;
+}
+
+void htable_add(htable_t *ht, struct hlist_node *node, u64 key)
+{
+    if (ht->old)
+        _rehash_some(ht);
+    hlist_add_head(node, ht->buckets + hash_64(key, ht->bits));
+    if (++ht->count > (u64) HTABLE_MAX_LOAD << ht->bits && !ht->old &&
+        ht->bits < HTABLE_MAX_BITS)
+        _resize(ht, ht->bits + 1);
+}
+
+void htable_del(htable_t *ht, struct hlist_node *node)
+{
+    hlist_del_init(node);
+    if (ht->old)
+        _rehash_some(ht);
+    if (--ht->count < (1UL << ht->bits) / HTABLE_MIN_LOAD_DIV && !ht->old &&
+        ht->bits > ht->minbits)
+        _resize(ht, ht->bits - 1);
+}
+
+void htable_stats(const htable_t *ht, hash_stats_t *stats)
+{
+    hash_stats_hlist(stats, ht->buckets, 1UL << ht->bits);
+    if (ht->old)
+        hash_stats_hlist(stats, ht->old + ht->rehash,
+                         (1UL << ht->oldbits) - ht->rehash);
+}
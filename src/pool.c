@@ -12,24 +12,180 @@
  */
 
 #include <stddef.h>
+#include <stdio.h>
 #include <malloc.h>
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
 
 #include "brlib.h"
+#include "bitops.h"
+#include "likely.h"
 #include "list.h"
 #include "pool.h"
 #include "debug.h"
 
+#if defined(POOL_STATS_LATENCY) && !defined(POOL_STATS)
+#define POOL_STATS
+#endif
+
+#ifdef POOL_HARDEN
+#define BITMAP_SIZE(nobjs) (((nobjs) + 63) / 64 * sizeof(u64))
+#endif
+
+#ifndef MPOL_BIND
+#define MPOL_BIND 2                               /* from <numaif.h> */
+#endif
+
+/* POOL_MT pools: each thread owns two magazines (loaded and previous), and
+ * the depot keeps the full and empty magazines not owned by any thread.
+ * This is the scheme described by Bonwick & Adams in "Magazines and Vmem"
+ * (USENIX 2001).
+ */
+typedef struct pool_mag {
+    struct pool_mag *next;                        /* depot stack link */
+    u32 count;                                    /* objects in magazine */
+    void *objs[];                                 /* magazine objects */
+} pool_mag_t;
+
+typedef struct {
+    pool_t *pool;                                 /* owner pool */
+    pool_mag_t *loaded;                           /* current magazine */
+    pool_mag_t *prev;                             /* previous magazine */
+    struct list_head list;                        /* depot threads caches list */
+#   ifdef POOL_STATS
+    pool_counters_t counters;                     /* thread gets/puts/latency */
+#   endif
+} pool_tcache_t;
+
+struct pool_depot {
+    pthread_mutex_t lock;                         /* protects depot & pool core */
+    pthread_key_t key;                            /* thread cache key */
+    u32 magsize;                                  /* objects per magazine */
+    u32 nfull;                                    /* full magazines in depot */
+    u32 nempty;                                   /* empty magazines in depot */
+    u32 nmags;                                    /* total magazines allocated */
+    pool_mag_t *full;                             /* full magazines stack */
+    pool_mag_t *empty;                            /* empty magazines stack */
+    struct list_head list_tcaches;                /* threads caches */
+};
+
+/* POOL_LOCKFREE pools: free objects links are kept in a Treiber stack. The
+ * stack top is a tagged pointer: the 48 low bits are the top link address,
+ * and the 16 high bits a counter incremented on each change, so that a pop
+ * cannot succeed if the top was popped and pushed back meanwhile (ABA).
+ */
+#define LF_PTR_BITS 48
+#define LF_PTR_MASK ((1ULL << LF_PTR_BITS) - 1)
+
+_Static_assert(sizeof(void *) == sizeof(u64),
+               "POOL_LOCKFREE tagged pointers need 64 bits pointers");
+
+struct pool_lf {
+    u64 top __aligned(POOL_CACHELINE_SIZE);       /* tagged free stack top */
+    pthread_mutex_t lock __aligned(POOL_CACHELINE_SIZE); /* grow lock */
+};
+
+/* POOL_STATS counters: a thread cache counters are only written by their
+ * owner thread, but may be read by pool_counters() at any time. Relaxed
+ * atomic accesses compile to plain loads and stores. POOL_LOCKFREE pools
+ * counters are shared, and updated with STAT_ADD_SHARED().
+ * Without POOL_STATS, STAT_ADD() and STAT_HIWATER() compile to nothing.
+ */
+#ifdef POOL_STATS
+static inline void _stat_add(u64 *counter, u64 n)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n,
+                     __ATOMIC_RELAXED);
+}
+
+static inline u64 _stat_read(u64 *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static inline u64 _stat_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline void _stat_hiwater(pool_t *pool)
+{
+    u64 out = pool->allocated - pool->available;
+
+    if (out > pool->counters->hiwater)
+        pool->counters->hiwater = out;
+}
+
+/* POOL_LOCKFREE pools do not maintain their available objects count: objects
+ * out of pool are gets - puts. puts is read first, so that concurrent gets
+ * can only make the result larger, and a negative result (an object released
+ * before its get was counted) is ignored.
+ */
+static inline void _stat_hiwater_shared(pool_counters_t *counters)
+{
+    u64 puts = _stat_read(&counters->puts);
+    s64 out = _stat_read(&counters->gets) - puts;
+    u64 hiwater = _stat_read(&counters->hiwater);
+
+    while (out > (s64) hiwater &&
+           !__atomic_compare_exchange_n(&counters->hiwater, &hiwater, out, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+#define STAT_ADD(counters, field, n) _stat_add(&(counters)->field, (n))
+#define STAT_ADD_SHARED(counters, field, n)                           \
+    __atomic_fetch_add(&(counters)->field, (n), __ATOMIC_RELAXED)
+#define STAT_HIWATER(pool)           _stat_hiwater(pool)
+#define STAT_HIWATER_SHARED(pool)    _stat_hiwater_shared((pool)->counters)
+#else
+#define STAT_ADD(counters, field, n) do { } while (0)
+#define STAT_ADD_SHARED(counters, field, n) do { } while (0)
+#define STAT_HIWATER(pool)           do { } while (0)
+#define STAT_HIWATER_SHARED(pool)    do { } while (0)
+#endif
+
 void pool_stats(pool_t *pool)
 {
     if (pool) {
         block_t *block;
 
-        log_f(1, "[%s] pool [%p]: blocks:%u avail:%u alloc:%u grow:%u eltsize:%zu\n",
-              pool->name, (void *)pool, pool->nblocks, pool->available,
-              pool->allocated, pool->growsize, pool->eltsize);
+        if (pool->lf)                             /* no available count */
+            log_f(1, "[%s] pool [%p]: blocks:%u lock-free alloc:%u grow:%u eltsize:%zu align:%zu blocksize:%zu\n",
+                  pool->name, (void *)pool, pool->nblocks, pool->allocated,
+                  pool->growsize, pool->eltsize, pool->align, pool->blocksize);
+        else
+            log_f(1, "[%s] pool [%p]: blocks:%u avail:%u (uncarved:%u) alloc:%u grow:%u eltsize:%zu align:%zu blocksize:%zu\n",
+                  pool->name, (void *)pool, pool->nblocks, pool->available,
+                  pool->uncarved, pool->allocated, pool->growsize, pool->eltsize,
+                  pool->align, pool->blocksize);
+        if (pool->flags & POOL_RECLAIM)
+            log_f(1, "[%s] reclaim: empty blocks:%u maxempty:%u reclaimed:%zu bytes\n",
+                  pool->name, pool->nempty, pool->maxempty, pool->reclaimed);
+        if (pool->depot) {
+            struct pool_depot *depot = pool->depot;
+            log_f(1, "[%s] depot: magsize:%u mags:%u full:%u empty:%u\n",
+                  pool->name, depot->magsize, depot->nmags, depot->nfull,
+                  depot->nempty);
+        }
+#       ifdef POOL_STATS
+        pool_counters_t counters;
+        pool_counters(pool, &counters);
+        log_f(1, "[%s] counters: gets:%llu puts:%llu inuse:%llu hiwater:%llu grows:%llu (%llu ns) reserved:%llu\n",
+              pool->name, (ullong) counters.gets, (ullong) counters.puts,
+              (ullong) counters.inuse, (ullong) counters.hiwater,
+              (ullong) counters.grows, (ullong) counters.grow_ns,
+              (ullong) counters.reserved);
+#       endif
         log(5, "\tblocks: ");
         list_for_each_entry(block, &pool->list_blocks, list_blocks) {
             log(5, "%p ", block);
@@ -38,40 +194,287 @@ void pool_stats(pool_t *pool)
     }
 }
 
-pool_t *pool_create(const char *name, u32 growsize, size_t eltsize)
+static pool_mag_t *_mag_alloc(struct pool_depot *depot)
+{
+    pool_mag_t *mag = malloc(sizeof(*mag) + depot->magsize * sizeof(void *));
+
+    if (mag)
+        mag->count = 0;
+    return mag;
+}
+
+static void _tcache_destructor(void *arg);
+static int _pool_grow(pool_t *pool);
+
+static struct pool_depot *_depot_create(u32 magsize)
+{
+    struct pool_depot *depot = malloc(sizeof(*depot));
+
+    if (!depot)
+        return NULL;
+    if (pthread_key_create(&depot->key, _tcache_destructor)) {
+        free(depot);
+        return NULL;
+    }
+    pthread_mutex_init(&depot->lock, NULL);
+    depot->magsize = magsize;
+    depot->nfull = depot->nempty = depot->nmags = 0;
+    depot->full = depot->empty = NULL;
+    INIT_LIST_HEAD(&depot->list_tcaches);
+    return depot;
+}
+
+pool_t *pool_create_attr(const char *name, u32 growsize, size_t eltsize,
+                         const pool_attr_t *attr)
 {
     pool_t *pool;
+    u32 flags = attr? attr->flags: 0;
+    size_t linkoff = attr? attr->linkoff: 0;
+    size_t minsize, blocksize, align = attr && attr->align? attr->align: 1;
+    size_t objsize, hdrsize, dataoff, blockalign;
 
 #   ifdef DEBUG_POOL
-    log_f(1, "name=[%s] growsize=%u eltsize=%zu\n", name, growsize, eltsize);
+    log_f(1, "name=[%s] growsize=%u eltsize=%zu flags=%#x\n", name, growsize,
+          eltsize, flags);
 #   endif
-    /* we need at least  sizeof(struct list_head) space in pool elements
+    /* we need at least sizeof(struct list_head) space in pool elements,
+     * or a pointer for singly-linked free list.
      */
-    if (eltsize < sizeof (struct list_head)) {
+    if (flags & POOL_LOCKFREE)
+        flags |= POOL_SLIST;
+    minsize = flags & POOL_SLIST? sizeof(void *): sizeof(struct list_head);
+    if (eltsize < minsize) {
 #       ifdef DEBUG_POOL
         log_f(1, "[%s]: structure size too small (%zu < %zu), adjusting to %zu.\n",
-              name, eltsize, sizeof(struct list_head), sizeof(struct list_head));
+              name, eltsize, minsize, minsize);
+#       endif
+        eltsize = minsize;
+    }
+    if (flags & POOL_CACHELINE && align < POOL_CACHELINE_SIZE)
+        align = POOL_CACHELINE_SIZE;
+    if (flags & POOL_LOCKFREE && flags & (POOL_MT | POOL_RECLAIM)) {
+#       ifdef DEBUG_POOL
+        log_f(1, "[%s]: POOL_LOCKFREE incompatible flags %#x\n", name, flags);
+#       endif
+        errno = EINVAL;
+        return NULL;
+    }
+    if (flags & POOL_NUMA &&
+        (attr->numa_node < 0 || attr->numa_node >= POOL_NUMA_NODES)) {
+#       ifdef DEBUG_POOL
+        log_f(1, "[%s]: invalid NUMA node %d\n", name, attr->numa_node);
+#       endif
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!is_pow2(align)) {
+#       ifdef DEBUG_POOL
+        log_f(1, "[%s]: invalid alignment %zu\n", name, align);
+#       endif
+        errno = EINVAL;
+        return NULL;
+    }
+    if (linkoff % sizeof(void *) || linkoff + minsize > eltsize) {
+#       ifdef DEBUG_POOL
+        log_f(1, "[%s]: invalid link offset %zu\n", name, linkoff);
 #       endif
-        eltsize = sizeof(struct list_head);
+        errno = EINVAL;
+        return NULL;
+    }
+    objsize = eltsize;
+    hdrsize = sizeof(block_t);
+#   ifdef POOL_HARDEN
+    eltsize += POOL_REDZONE_SIZE;
+    hdrsize += BITMAP_SIZE(growsize);
+#   endif
+    eltsize = ALIGN(eltsize, align);
+    dataoff = ALIGN(hdrsize, max(align, __alignof__(max_align_t)));
+    if (flags & (POOL_HUGEPAGE | POOL_NUMA))
+        flags |= POOL_MMAP;
+    blocksize = attr && attr->blocksize?
+        attr->blocksize: dataoff + eltsize * growsize;
+    blockalign = align;
+    if (flags & POOL_MMAP) {
+        size_t pagesize = flags & POOL_HUGEPAGE?
+            POOL_HUGEPAGE_SIZE: (size_t) sysconf(_SC_PAGESIZE);
+        blocksize = ALIGN(blocksize, pagesize);
     }
+    if (flags & POOL_RECLAIM) {
+        /* block address is found by masking objects address
+         */
+        blocksize = 1UL << fls64(blocksize - 1);
+        blockalign = blocksize;
+    }
+#   ifdef POOL_HARDEN
+    if (flags & (POOL_MMAP | POOL_RECLAIM) || (attr && attr->blocksize)) {
+        /* bitmap must cover the adjusted grow size */
+        hdrsize = sizeof(block_t) + BITMAP_SIZE(blocksize / eltsize);
+        dataoff = ALIGN(hdrsize, max(align, __alignof__(max_align_t)));
+    }
+#   endif
+    if (blocksize < dataoff + eltsize) {
+#       ifdef DEBUG_POOL
+        log_f(1, "[%s]: block size too small (%zu)\n", name, blocksize);
+#       endif
+        errno = EINVAL;
+        return NULL;
+    }
+    growsize = (blocksize - dataoff) / eltsize;
     if ((pool = malloc(sizeof (*pool)))) {
         strncpy(pool->name, name, POOL_NAME_LENGTH - 1);
         pool->name[POOL_NAME_LENGTH - 1] = 0;
+        pool->flags = flags;
         pool->growsize = growsize;
+        pool->objsize = objsize;
         pool->eltsize = eltsize;
+        pool->align = align;
+        pool->dataoff = dataoff;
+        pool->linkoff = linkoff;
+        pool->ctor = attr? attr->ctor: NULL;
+        pool->dtor = attr? attr->dtor: NULL;
         pool->available = 0;
+        pool->uncarved = 0;
+        pool->carve = NULL;
         pool->allocated = 0;
         pool->nblocks = 0;
+        pool->nempty = 0;
+        pool->maxempty = attr? attr->maxempty: 0;
+        pool->blocksize = blocksize;
+        pool->blockalign = blockalign;
+        pool->reclaimed = 0;
+        pool->numa_node = flags & POOL_NUMA? attr->numa_node: -1;
+        pool->depot = NULL;
+        pool->lf = NULL;
+        pool->counters = NULL;
+        pool->first_available = NULL;
         INIT_LIST_HEAD(&pool->list_available);
         INIT_LIST_HEAD(&pool->list_blocks);
+        INIT_LIST_HEAD(&pool->list_partial);
+        INIT_LIST_HEAD(&pool->list_empty);
+#       ifdef POOL_STATS
+        if (!(pool->counters = calloc(1, sizeof(*pool->counters)))) {
+            free(pool);
+            errno = ENOMEM;
+            return NULL;
+        }
+#       endif
+        if (flags & POOL_MT) {
+            u32 magsize = attr->magsize? attr->magsize: POOL_MAG_SIZE;
+            if (!(pool->depot = _depot_create(magsize))) {
+                free(pool->counters);
+                free(pool);
+                pool = NULL;
+                errno = ENOMEM;
+            }
+        }
+        if (flags & POOL_LOCKFREE) {
+            if (posix_memalign((void **)&pool->lf, POOL_CACHELINE_SIZE,
+                               sizeof(*pool->lf))) {
+                free(pool->counters);
+                free(pool);
+                errno = ENOMEM;
+                return NULL;
+            }
+            pool->lf->top = 0;
+            pthread_mutex_init(&pool->lf->lock, NULL);
+        }
+        /* preallocate the only block */
+        if (pool && flags & POOL_FIXED && _pool_grow(pool)) {
+            int err = errno;
+            pool_destroy(pool);
+            pool = NULL;
+            errno = err;
+        }
     } else {
         errno = ENOMEM;
     }
     return pool;
 }
 
-static u32 _pool_add(pool_t *pool, struct list_head *elt)
+pool_t *pool_create(const char *name, u32 growsize, size_t eltsize)
+{
+    return pool_create_attr(name, growsize, eltsize, NULL);
+}
+
+static inline block_t *_block_of(pool_t *pool, void *obj)
+{
+    return (block_t *)((uintptr_t)obj & ~(pool->blocksize - 1));
+}
+
+/* free list links are at @pool->linkoff in objects.
+ */
+static inline void *_obj_link(pool_t *pool, void *obj)
+{
+    return (char *)obj + pool->linkoff;
+}
+
+static inline void *_link_obj(pool_t *pool, void *link)
 {
+    return (char *)link - pool->linkoff;
+}
+
+/* POOL_RECLAIM pools: free objects are kept in a stack in their block (the
+ * link is always a pointer). Blocks with free objects are either in the
+ * partial list (some objects in use), or in the empty list (no object in
+ * use), so that pool_trim() finds empty blocks without looking at objects.
+ * Blocks without free objects (full ones, or the block being carved) are in
+ * none of these lists.
+ */
+static inline void _reclaim_put(pool_t *pool, void *obj)
+{
+    block_t *block = _block_of(pool, obj);
+    void **link = _obj_link(pool, obj);
+
+    *link = block->first_free;
+    block->first_free = link;
+    if (!--block->live) {
+        list_move(&block->list_free, &pool->list_empty);
+        pool->nempty++;
+    } else if (!*link) {
+        list_add(&block->list_free, &pool->list_partial);
+    }
+}
+
+static inline void *_reclaim_get(pool_t *pool)
+{
+    struct list_head *head = list_empty(&pool->list_partial)?
+        &pool->list_empty: &pool->list_partial;
+    block_t *block = list_first_entry(head, block_t, list_free);
+    void **link = block->first_free;
+
+    block->first_free = *link;
+    if (!block->live++)
+        pool->nempty--;
+    if (!block->first_free)
+        list_del_init(&block->list_free);
+    else if (head == &pool->list_empty)
+        list_move(&block->list_free, &pool->list_partial);
+    return _link_obj(pool, link);
+}
+
+/* POOL_RECLAIM: a never used object is carved from its block.
+ */
+static inline void _block_carve(pool_t *pool, void *obj)
+{
+    if (pool->flags & POOL_RECLAIM)
+        _block_of(pool, obj)->live++;
+}
+
+static size_t _pool_trim(pool_t *pool, u32 keep);
+
+/* automatic trim, after objects release: at most one block is released for
+ * each block becoming empty.
+ */
+static inline void _pool_autotrim(pool_t *pool)
+{
+    if (unlikely(pool->maxempty && pool->nempty > pool->maxempty))
+        _pool_trim(pool, pool->maxempty);
+}
+
+static u32 _pool_add(pool_t *pool, void *elt)
+{
+    void *link = _obj_link(pool, elt);
+
 #   ifdef DEBUG_POOL
     log_f(6, "pool=%p &head=%p elt=%p off1=%zu off2=%zu\n",
           (void *)pool, (void *)&pool->list_available, (void *)elt,
@@ -79,64 +482,1117 @@ static u32 _pool_add(pool_t *pool, struct list_head *elt)
           offsetof(pool_t, list_available));
 #   endif
 
-    list_add(elt, &pool->list_available);
-    return ++pool->available;
+    pool->available++;
+    if (pool->flags & POOL_RECLAIM) {
+        _reclaim_put(pool, elt);
+        _pool_autotrim(pool);
+    } else if (pool->flags & POOL_SLIST) {
+        *(void **)link = pool->first_available;
+        pool->first_available = link;
+    } else {
+        list_add(link, &pool->list_available);
+    }
+    return pool->available;
 }
 
-u32 pool_add(pool_t *pool, void *elt)
+static void *_pool_get(pool_t *pool)
 {
-    return _pool_add(pool, elt);
+    void *res;
+
+    pool->available--;
+    if (pool->flags & POOL_RECLAIM)
+        return _reclaim_get(pool);
+    if (pool->flags & POOL_SLIST) {
+        res = pool->first_available;
+        pool->first_available = *(void **)res;
+    } else {
+        res = pool->list_available.next;
+        list_del(res);
+    }
+    return _link_obj(pool, res);
 }
 
-static struct list_head *_pool_get(pool_t *pool)
+/**
+ * _block_malloc - allocate a standard block.
+ * @pool:    The pool address.
+ *
+ * Return:   The block address, or NULL if error (errno is set to ENOMEM).
+ */
+static block_t *_block_malloc(pool_t *pool)
 {
-    struct list_head *res = pool->list_available.next;
-    pool->available--;
-    list_del(res);
-    return res;
+    void *block;
+
+    if (pool->blockalign <= __alignof__(max_align_t))
+        return malloc(pool->blocksize);
+    if (posix_memalign(&block, pool->blockalign, pool->blocksize)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return block;
 }
 
-void *pool_get(pool_t *pool)
+/**
+ * _mmap_aligned - anonymous mapping with alignment greater than page size.
+ * @size:    The mapping size.
+ * @align:   The mapping alignment (power of 2).
+ *
+ * Return:   The mapping address, or MAP_FAILED if error.
+ */
+static void *_mmap_aligned(size_t size, size_t align)
 {
-    if (!pool)
+    char *map = mmap(NULL, size + align, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    char *start;
+
+    if (map == MAP_FAILED)
+        return MAP_FAILED;
+    start = (char *)ALIGN((uintptr_t)map, align);
+    if (start > map)
+        munmap(map, start - map);
+    munmap(start + size, map + align - start);
+    return start;
+}
+
+/**
+ * _block_mmap - allocate a POOL_MMAP block.
+ * @pool:    The pool address.
+ *
+ * POOL_NUMA blocks are released if they cannot be bound to the pool node.
+ *
+ * Return:   The block address, or NULL if error (errno is set).
+ */
+static block_t *_block_mmap(pool_t *pool)
+{
+    size_t size = pool->blocksize, align = pool->blockalign;
+    void *block = MAP_FAILED;
+
+    if (pool->flags & POOL_HUGEPAGE) {
+        if (align <= POOL_HUGEPAGE_SIZE)
+            block = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (block == MAP_FAILED) {
+            /* no huge pages available: get an aligned mapping for
+             * transparent huge pages.
+             */
+            block = _mmap_aligned(size, max(align, POOL_HUGEPAGE_SIZE));
+            if (block != MAP_FAILED)
+                madvise(block, size, MADV_HUGEPAGE);
+        }
+    } else if (align > (size_t) sysconf(_SC_PAGESIZE)) {
+        block = _mmap_aligned(size, align);
+    } else {
+        block = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (block == MAP_FAILED)
         return NULL;
-    if (!pool->available) {
-        block_t *block = malloc(sizeof(block_t) + pool->eltsize * pool->growsize);
-        if (!block) {
+    if (pool->flags & POOL_NUMA) {
+        unsigned long nodemask[POOL_NUMA_NODES / BITS_PER_LONG] = { 0 };
+        int node = pool->numa_node;
+
+        nodemask[node / BITS_PER_LONG] = 1UL << (node % BITS_PER_LONG);
+        if (syscall(SYS_mbind, block, size, MPOL_BIND, nodemask,
+                    POOL_NUMA_NODES, 0)) {
+            int err = errno;
 #           ifdef DEBUG_POOL
-            log_f(1, "[%s]: failed block allocation\n", pool->name);
+            log_f(1, "[%s]: mbind(node=%d) failed\n", pool->name, node);
 #           endif
-            errno = ENOMEM;
+            munmap(block, size);
+            errno = err;
             return NULL;
         }
+    }
+    return block;
+}
 
-        /* maintain list of allocated blocks
-         */
-        list_add(&block->list_blocks, &pool->list_blocks);
-        pool->nblocks++;
+static void _block_free(pool_t *pool, block_t *block)
+{
+    if (pool->flags & POOL_MLOCK)
+        munlock(block, pool->blocksize);
+    if (pool->flags & POOL_MMAP)
+        munmap(block, pool->blocksize);
+    else
+        free(block);
+}
+
+/* POOL_FIXED: touch all block pages, so that no page fault happens later.
+ */
+static void _block_prefault(pool_t *pool, block_t *block)
+{
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+
+    for (size_t off = 0; off < pool->blocksize; off += pagesize)
+        ((volatile char *)block)[off] = 0;
+}
+
+/* POOL_HARDEN checks, see pool.h. Each block header is followed by the
+ * bitmap of its objects in use.
+ * Without POOL_HARDEN, HARDEN_GET() and HARDEN_PUT() compile to nothing.
+ */
+#ifdef POOL_HARDEN
+static void _harden_fail(pool_t *pool, void *obj, const char *msg)
+{
+    fprintf(stderr, "** POOL [%s]: object %p: %s.\n", pool->name, obj, msg);
+    abort();
+    /* not reached */
+}
+
+/* bitmap words must not cross cache lines (atomic operations): it starts
+ * after block_t padding, not at block->data.
+ */
+static inline u64 *_harden_bitmap(block_t *block)
+{
+    return (u64 *)((char *)block + sizeof(block_t));
+}
+
+static void _harden_block_init(pool_t *pool, block_t *block)
+{
+    char *obj = (char *)block + pool->dataoff;
+
+    memset(_harden_bitmap(block), 0, BITMAP_SIZE(pool->growsize));
+    for (u32 i = 0; i < pool->growsize; ++i, obj += pool->eltsize) {
+        memset(obj, POOL_POISON_FREE, pool->objsize);
+        memset(obj + pool->objsize, POOL_POISON_RED, pool->eltsize - pool->objsize);
+    }
+}
+
+static inline bool _harden_inside(pool_t *pool, block_t *block, void *obj)
+{
+    char *data = (char *)block + pool->dataoff;
 
+    return (char *)obj >= data &&
+        (char *)obj < data + (size_t) pool->growsize * pool->eltsize;
+}
+
+/**
+ * _harden_block - find the block of an object.
+ * @pool:    The pool address.
+ * @obj:     The object address.
+ *
+ * The blocks list is scanned, also for POOL_RECLAIM pools: nothing is read
+ * at @obj (or at its masked) address, so that a foreign address is reported
+ * instead of being dereferenced.
+ *
+ * Return:   The block containing @obj, or NULL if @obj is not the address of
+ *           an object in one of @pool blocks.
+ */
+static block_t *_harden_block(pool_t *pool, void *obj)
+{
+    pthread_mutex_t *lock = pool->depot? &pool->depot->lock:
+        pool->lf? &pool->lf->lock: NULL;
+    block_t *block, *res = NULL;
+
+    if (lock)
+        pthread_mutex_lock(lock);
+    list_for_each_entry(block, &pool->list_blocks, list_blocks) {
+        if (_harden_inside(pool, block, obj)) {
+            res = block;
+            break;
+        }
+    }
+    if (lock)
+        pthread_mutex_unlock(lock);
+    if (res && ((char *)obj - ((char *)res + pool->dataoff)) % pool->eltsize)
+        res = NULL;
+    return res;
+}
+
+/**
+ * _harden_mark - set an object in-use bit.
+ * @pool:    The pool address.
+ * @block:   The object block.
+ * @obj:     The object address.
+ * @inuse:   The new object state.
+ *
+ * Return:   The previous object state.
+ */
+static inline bool _harden_mark(pool_t *pool, block_t *block, void *obj, bool inuse)
+{
+    size_t idx = ((char *)obj - ((char *)block + pool->dataoff)) / pool->eltsize;
+    u64 *word = _harden_bitmap(block) + idx / 64, bit = 1ULL << (idx % 64), old;
+
+    if (inuse)
+        old = __atomic_fetch_or(word, bit, __ATOMIC_RELAXED);
+    else
+        old = __atomic_fetch_and(word, ~bit, __ATOMIC_RELAXED);
+    return old & bit;
+}
+
+static inline bool _harden_poisoned(const char *mem, int c, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        if (mem[i] != (char) c)
+            return false;
+    return true;
+}
+
+static void _harden_get(pool_t *pool, void *obj)
+{
+    size_t linkend = pool->linkoff +
+        (pool->flags & (POOL_SLIST | POOL_RECLAIM)?
+         sizeof(void *): sizeof(struct list_head));
+    block_t *block = _harden_block(pool, obj);
+
+    if (!block)
+        _harden_fail(pool, obj, "free list corrupted, not a pool object");
+    if (_harden_mark(pool, block, obj, true))
+        _harden_fail(pool, obj, "free list corrupted, object in use");
+    if (!pool->ctor &&
+        (!_harden_poisoned(obj, POOL_POISON_FREE, pool->linkoff) ||
+         !_harden_poisoned((char *)obj + linkend, POOL_POISON_FREE,
+                           pool->objsize - linkend)))
+        _harden_fail(pool, obj, "object modified after release");
+    if (!_harden_poisoned((char *)obj + pool->objsize, POOL_POISON_RED,
+                          pool->eltsize - pool->objsize))
+        _harden_fail(pool, obj, "red zone overwritten");
+}
+
+static void _harden_put(pool_t *pool, void *obj)
+{
+    block_t *block = _harden_block(pool, obj);
+
+    if (!block)
+        _harden_fail(pool, obj, "not a pool object");
+    if (!_harden_mark(pool, block, obj, false))
+        _harden_fail(pool, obj, "double free");
+    if (!_harden_poisoned((char *)obj + pool->objsize, POOL_POISON_RED,
+                          pool->eltsize - pool->objsize))
+        _harden_fail(pool, obj, "red zone overwritten");
+    if (!pool->ctor)
+        memset(obj, POOL_POISON_FREE, pool->objsize);
+}
+
+#define HARDEN_GET(pool, obj) _harden_get(pool, obj)
+#define HARDEN_PUT(pool, obj) _harden_put(pool, obj)
+#else
+#define HARDEN_GET(pool, obj) do { } while (0)
+#define HARDEN_PUT(pool, obj) do { } while (0)
+#endif
+
+/**
+ * _pool_grow - add a new block of objects to pool.
+ * @pool:    The pool address.
+ *
+ * Return:   0 if success, -1 otherwise.
+ */
+static int _pool_grow(pool_t *pool)
+{
+    block_t *block;
+#   ifdef POOL_STATS
+    u64 start = _stat_ns();
+#   endif
+
+    if (pool->flags & POOL_FIXED && pool->nblocks) {
+#       ifdef DEBUG_POOL
+        log_f(3, "[%s]: fixed pool exhausted\n", pool->name);
+#       endif
+        errno = ENOBUFS;
+        return -1;
+    }
+    block = pool->flags & POOL_MMAP? _block_mmap(pool): _block_malloc(pool);
+    if (block && pool->flags & POOL_MLOCK && mlock(block, pool->blocksize)) {
+        int err = errno;
+#       ifdef DEBUG_POOL
+        log_f(1, "[%s]: mlock failed\n", pool->name);
+#       endif
+        _block_free(pool, block);
+        errno = err;
+        return -1;
+    }
+#   ifdef POOL_STATS
+    STAT_ADD(pool->counters, grow_ns, _stat_ns() - start);
+#   endif
+    if (!block) {
+#       ifdef DEBUG_POOL
+        log_f(1, "[%s]: failed block allocation\n", pool->name);
+#       endif
+        return -1;
+    }
+    if (pool->lf && ((uintptr_t)block + pool->blocksize - 1) & ~LF_PTR_MASK) {
+        /* objects links would not fit in tagged stack top */
 #       ifdef DEBUG_POOL
-        log_f(1, "[%s]: growing pool from %u to %u elements. block=%p nblocks=%u\n",
-              pool->name,
-              pool->allocated,
-              pool->allocated + pool->growsize,
-              block,
-              pool->nblocks);
+        log_f(1, "[%s]: block %p above 2^%d\n", pool->name, (void *)block,
+              LF_PTR_BITS);
 #       endif
+        _block_free(pool, block);
+        errno = ENOMEM;
+        return -1;
+    }
+    if (pool->flags & POOL_FIXED && !(pool->flags & POOL_MLOCK))
+        _block_prefault(pool, block);
 
-        pool->allocated += pool->growsize;
-        for (u32 i = 0; i < pool->growsize; ++i) {
-            void *cur = block->data + i * pool->eltsize;
-#           ifdef DEBUG_POOL
-            log_f(7, "alloc=%p cur=%p\n", block, cur);
-#           endif
-            _pool_add(pool, (struct list_head *)cur);
+    /* maintain list of allocated blocks
+     */
+    list_add(&block->list_blocks, &pool->list_blocks);
+    pool->nblocks++;
+    block->pool = pool;
+    block->live = 0;
+    INIT_LIST_HEAD(&block->list_free);
+    block->first_free = NULL;
+
+#   ifdef DEBUG_POOL
+    log_f(1, "[%s]: growing pool from %u to %u elements. block=%p nblocks=%u\n",
+          pool->name,
+          pool->allocated,
+          pool->allocated + pool->growsize,
+          block,
+          pool->nblocks);
+#   endif
+
+    /* elements will be carved from the new block on demand
+     */
+    pool->allocated += pool->growsize;
+    pool->available += pool->growsize;
+    pool->uncarved = pool->growsize;
+    pool->carve = (char *)block + pool->dataoff;
+#   ifdef POOL_HARDEN
+    _harden_block_init(pool, block);
+#   endif
+    STAT_ADD(pool->counters, grows, 1);
+    STAT_ADD(pool->counters, reserved, pool->blocksize);
+    return 0;
+}
+
+/* single-threaded pool core: used directly for standard pools, and with
+ * depot lock held for POOL_MT pools.
+ */
+static void *_pool_alloc(pool_t *pool)
+{
+    void *res;
+
+    /* free list is not empty: released objects are used first
+     */
+    if (pool->available > pool->uncarved) {
+        res = _pool_get(pool);
+        STAT_HIWATER(pool);
+        return res;
+    }
+
+    if (!pool->uncarved && _pool_grow(pool))
+        return NULL;
+    res = pool->carve;
+    pool->carve += pool->eltsize;
+    pool->uncarved--;
+    pool->available--;
+    _block_carve(pool, res);
+    if (pool->ctor)
+        pool->ctor(res);
+    STAT_HIWATER(pool);
+#   ifdef DEBUG_POOL
+    log_f(7, "carved=%p uncarved=%u\n", res, pool->uncarved);
+#   endif
+    return res;
+}
+
+/**
+ * _pool_alloc_bulk - get several objects from pool core.
+ * @pool:    The pool address.
+ * @objs:    The array to fill.
+ * @n:       The number of objects to get.
+ *
+ * The free list segment is detached at once, then the remaining objects are
+ * carved.
+ *
+ * Return:   The number of objects in @objs.
+ */
+static u32 _pool_alloc_bulk(pool_t *pool, void **objs, u32 n)
+{
+    u32 nfree = min(n, pool->available - pool->uncarved), done;
+
+    if (nfree) {
+        if (pool->flags & POOL_RECLAIM) {
+            for (done = 0; done < nfree; ++done)
+                objs[done] = _reclaim_get(pool);
+        } else if (pool->flags & POOL_SLIST) {
+            void *cur = pool->first_available;
+            for (done = 0; done < nfree; ++done) {
+                objs[done] = _link_obj(pool, cur);
+                cur = *(void **)cur;
+            }
+            pool->first_available = cur;
+        } else {
+            struct list_head *cur = &pool->list_available, cut;
+            for (done = 0; done < nfree; ++done) {
+                cur = cur->next;
+                objs[done] = _link_obj(pool, cur);
+            }
+            list_cut_position(&cut, &pool->list_available, cur);
+        }
+        pool->available -= nfree;
+    }
+    done = nfree;
+    while (done < n) {
+        u32 nb;
+
+        if (!pool->uncarved && _pool_grow(pool))
+            break;
+        nb = min(n - done, pool->uncarved);
+        for (u32 i = 0; i < nb; ++i, pool->carve += pool->eltsize) {
+            objs[done++] = pool->carve;
+            _block_carve(pool, pool->carve);
+            if (pool->ctor)
+                pool->ctor(pool->carve);
+        }
+        pool->uncarved -= nb;
+        pool->available -= nb;
+    }
+    STAT_HIWATER(pool);
+    return done;
+}
+
+/**
+ * _pool_add_bulk - add several objects to pool core.
+ * @pool:    The pool address.
+ * @objs:    The objects array.
+ * @n:       The number of objects in @objs.
+ *
+ * Objects are first chained together, then spliced at once to the free list.
+ *
+ * Return:   The current number of available objects in pool.
+ */
+static u32 _pool_add_bulk(pool_t *pool, void **objs, u32 n)
+{
+    if (!n)
+        return pool->available;
+    pool->available += n;
+    if (pool->flags & POOL_RECLAIM) {
+        for (u32 i = 0; i < n; ++i)
+            _reclaim_put(pool, objs[i]);
+        _pool_autotrim(pool);
+    } else if (pool->flags & POOL_SLIST) {
+        for (u32 i = 0; i < n - 1; ++i)
+            *(void **)_obj_link(pool, objs[i]) = _obj_link(pool, objs[i + 1]);
+        *(void **)_obj_link(pool, objs[n - 1]) = pool->first_available;
+        pool->first_available = _obj_link(pool, objs[0]);
+    } else {
+        LIST_HEAD(chain);
+        for (u32 i = 0; i < n; ++i)
+            list_add_tail(_obj_link(pool, objs[i]), &chain);
+        list_splice(&chain, &pool->list_available);
+    }
+    return pool->available;
+}
+
+/**
+ * _block_dtor - call destructor on a block objects.
+ * @pool:    The pool address.
+ * @block:   The block.
+ * @carve:   The next object to carve, or NULL.
+ *
+ * Only carved objects are destructed: if @carve is in @block, objects from
+ * @carve are skipped.
+ */
+static void _block_dtor(pool_t *pool, block_t *block, char *carve)
+{
+    char *obj = (char *)block + pool->dataoff;
+    char *end = obj + (size_t) pool->growsize * pool->eltsize;
+
+    if (carve >= obj && carve < end)
+        end = carve;
+    for (; obj < end; obj += pool->eltsize)
+        pool->dtor(obj);
+}
+
+/**
+ * _pool_trim - release free blocks.
+ * @pool:    The pool address.
+ * @keep:    The number of free blocks to keep.
+ *
+ * The blocks which became empty first are released: all their objects are
+ * either in their own free stack or uncarved.
+ *
+ * Return:   The number of bytes released.
+ */
+static size_t _pool_trim(pool_t *pool, u32 keep)
+{
+    char *carve = pool->uncarved? pool->carve: NULL;
+    u32 ndead = 0;
+    size_t res;
+
+    if (pool->flags & POOL_FIXED)
+        return 0;
+    while (pool->nempty > keep) {
+        block_t *block = list_last_entry(&pool->list_empty, block_t, list_free);
+
+        if (carve && _block_of(pool, carve) == block) {
+            pool->uncarved = 0;
+            pool->carve = NULL;
+        }
+        list_del(&block->list_free);
+        list_del(&block->list_blocks);
+        if (pool->dtor)
+            _block_dtor(pool, block, carve);
+        _block_free(pool, block);
+        pool->nempty--;
+        ndead++;
+    }
+    res = (size_t) ndead * pool->blocksize;
+    pool->nblocks -= ndead;
+    pool->allocated -= ndead * pool->growsize;
+    pool->available -= ndead * pool->growsize;
+    pool->reclaimed += res;
+    STAT_ADD(pool->counters, reserved, -res);
+#   ifdef DEBUG_POOL
+    if (ndead)
+        log_f(1, "[%s]: released %u blocks (%zu bytes)\n", pool->name,
+              ndead, res);
+#   endif
+    return res;
+}
+
+/**
+ * _tcache_release - give back a thread cache magazines to depot.
+ * @tcache:  the thread cache.
+ *
+ * Full magazines go to the depot full stack, and partial ones are emptied
+ * into the pool. Must be called with depot lock held.
+ */
+static void _tcache_release(pool_tcache_t *tcache)
+{
+    pool_t *pool = tcache->pool;
+    struct pool_depot *depot = pool->depot;
+    pool_mag_t *mags[2] = { tcache->loaded, tcache->prev };
+
+    for (int i = 0; i < 2; ++i) {
+        pool_mag_t *mag = mags[i];
+        if (mag->count == depot->magsize) {
+            mag->next = depot->full;
+            depot->full = mag;
+            depot->nfull++;
+        } else {
+            _pool_add_bulk(pool, mag->objs, mag->count);
+            mag->count = 0;
+            mag->next = depot->empty;
+            depot->empty = mag;
+            depot->nempty++;
+        }
+    }
+#   ifdef POOL_STATS
+    STAT_ADD(pool->counters, gets, tcache->counters.gets);
+    STAT_ADD(pool->counters, puts, tcache->counters.puts);
+    for (int i = 0; i < POOL_LATENCY_BUCKETS; ++i)
+        STAT_ADD(pool->counters, latency[i], tcache->counters.latency[i]);
+#   endif
+    list_del(&tcache->list);
+    free(tcache);
+}
+
+/* pthread key destructor, called at thread exit.
+ */
+static void _tcache_destructor(void *arg)
+{
+    pool_tcache_t *tcache = arg;
+    struct pool_depot *depot = tcache->pool->depot;
+
+    pthread_mutex_lock(&depot->lock);
+    _tcache_release(tcache);
+    pthread_mutex_unlock(&depot->lock);
+}
+
+static pool_tcache_t *_tcache_create(pool_t *pool)
+{
+    struct pool_depot *depot = pool->depot;
+    pool_tcache_t *tcache = malloc(sizeof(*tcache));
+    pool_mag_t *loaded = _mag_alloc(depot), *prev = _mag_alloc(depot);
+
+    if (!tcache || !loaded || !prev) {
+        free(tcache);
+        free(loaded);
+        free(prev);
+        errno = ENOMEM;
+        return NULL;
+    }
+    tcache->pool = pool;
+    tcache->loaded = loaded;
+    tcache->prev = prev;
+#   ifdef POOL_STATS
+    memset(&tcache->counters, 0, sizeof(tcache->counters));
+#   endif
+    pthread_mutex_lock(&depot->lock);
+    depot->nmags += 2;
+    list_add(&tcache->list, &depot->list_tcaches);
+    pthread_mutex_unlock(&depot->lock);
+    pthread_setspecific(depot->key, tcache);
+#   ifdef DEBUG_POOL
+    log_f(2, "[%s]: new thread cache %p\n", pool->name, (void *)tcache);
+#   endif
+    return tcache;
+}
+
+static inline pool_tcache_t *_tcache_get(pool_t *pool)
+{
+    pool_tcache_t *tcache = pthread_getspecific(pool->depot->key);
+
+    if (unlikely(!tcache))
+        tcache = _tcache_create(pool);
+    return tcache;
+}
+
+/**
+ * _pool_mt_fill - reload thread cache loaded magazine.
+ * @pool:    The pool address.
+ * @tcache:  The thread cache.
+ *
+ * Called when both thread magazines are empty: a full magazine is taken from
+ * depot if any, otherwise the loaded magazine is filled from pool.
+ *
+ * Return:   0 if at least one object is available in loaded magazine, -1
+ *           otherwise.
+ */
+static int _pool_mt_fill(pool_t *pool, pool_tcache_t *tcache)
+{
+    struct pool_depot *depot = pool->depot;
+    pool_mag_t *loaded = tcache->loaded;
+
+    pthread_mutex_lock(&depot->lock);
+    if (depot->full) {
+        pool_mag_t *full = depot->full;
+        depot->full = full->next;
+        depot->nfull--;
+        tcache->prev->next = depot->empty;
+        depot->empty = tcache->prev;
+        depot->nempty++;
+        tcache->prev = loaded;
+        tcache->loaded = full;
+    } else {
+        loaded->count += _pool_alloc_bulk(pool, loaded->objs + loaded->count,
+                                          depot->magsize - loaded->count);
+    }
+    pthread_mutex_unlock(&depot->lock);
+    return tcache->loaded->count? 0: -1;
+}
+
+/**
+ * _pool_mt_flush - get an empty loaded magazine.
+ * @pool:    The pool address.
+ * @tcache:  The thread cache.
+ *
+ * Called when both thread magazines are full: previous one is given to depot,
+ * and an empty one is taken from depot or allocated.
+ *
+ * Return:   0 if loaded magazine is empty, -1 otherwise.
+ */
+static int _pool_mt_flush(pool_t *pool, pool_tcache_t *tcache)
+{
+    struct pool_depot *depot = pool->depot;
+    pool_mag_t *empty;
+
+    pthread_mutex_lock(&depot->lock);
+    if ((empty = depot->empty)) {
+        depot->empty = empty->next;
+        depot->nempty--;
+    } else if ((empty = _mag_alloc(depot))) {
+        depot->nmags++;
+    } else {
+        pthread_mutex_unlock(&depot->lock);
+        return -1;
+    }
+    tcache->prev->next = depot->full;
+    depot->full = tcache->prev;
+    depot->nfull++;
+    pthread_mutex_unlock(&depot->lock);
+    tcache->prev = tcache->loaded;
+    tcache->loaded = empty;
+    return 0;
+}
+
+static void *_pool_mt_get(pool_t *pool)
+{
+    pool_tcache_t *tcache = _tcache_get(pool);
+
+    if (unlikely(!tcache))
+        return NULL;
+    if (unlikely(!tcache->loaded->count)) {
+        if (tcache->prev->count) {
+            swap(tcache->loaded, tcache->prev);
+        } else if (_pool_mt_fill(pool, tcache)) {
+            return NULL;
+        }
+    }
+    STAT_ADD(&tcache->counters, gets, 1);
+    return tcache->loaded->objs[--tcache->loaded->count];
+}
+
+static u32 _pool_mt_get_bulk(pool_t *pool, void **objs, u32 n)
+{
+    pool_tcache_t *tcache = _tcache_get(pool);
+    u32 done = 0;
+
+    if (unlikely(!tcache))
+        return 0;
+    while (done < n) {
+        pool_mag_t *loaded = tcache->loaded;
+        u32 nb = min(n - done, loaded->count);
+
+        loaded->count -= nb;
+        memcpy(objs + done, loaded->objs + loaded->count, nb * sizeof(void *));
+        done += nb;
+        if (done < n) {
+            if (tcache->prev->count)
+                swap(tcache->loaded, tcache->prev);
+            else if (_pool_mt_fill(pool, tcache))
+                break;
+        }
+    }
+    STAT_ADD(&tcache->counters, gets, done);
+    return done;
+}
+
+static u32 _pool_mt_add(pool_t *pool, void *elt)
+{
+    struct pool_depot *depot = pool->depot;
+    pool_tcache_t *tcache = _tcache_get(pool);
+
+    if (unlikely(!tcache))
+        goto to_pool;
+    if (unlikely(tcache->loaded->count == depot->magsize)) {
+        if (!tcache->prev->count)
+            swap(tcache->loaded, tcache->prev);
+        else if (_pool_mt_flush(pool, tcache))
+            goto to_pool;
+    }
+    tcache->loaded->objs[tcache->loaded->count++] = elt;
+    STAT_ADD(&tcache->counters, puts, 1);
+    return tcache->loaded->count;
+
+to_pool:
+    pthread_mutex_lock(&depot->lock);
+    STAT_ADD(pool->counters, puts, 1);
+    _pool_add(pool, elt);
+    pthread_mutex_unlock(&depot->lock);
+    return 0;
+}
+
+static u32 _pool_mt_add_bulk(pool_t *pool, void **objs, u32 n)
+{
+    struct pool_depot *depot = pool->depot;
+    pool_tcache_t *tcache = _tcache_get(pool);
+    u32 done = 0;
+
+    if (unlikely(!tcache))
+        goto to_pool;
+    while (done < n) {
+        pool_mag_t *loaded = tcache->loaded;
+        u32 nb = min(n - done, depot->magsize - loaded->count);
+
+        memcpy(loaded->objs + loaded->count, objs + done, nb * sizeof(void *));
+        loaded->count += nb;
+        done += nb;
+        if (done < n) {
+            if (!tcache->prev->count)
+                swap(tcache->loaded, tcache->prev);
+            else if (_pool_mt_flush(pool, tcache))
+                goto to_pool;
+        }
+    }
+    STAT_ADD(&tcache->counters, puts, n);
+    return tcache->loaded->count;
+
+to_pool:
+    pthread_mutex_lock(&depot->lock);
+    if (tcache)
+        STAT_ADD(&tcache->counters, puts, done);
+    STAT_ADD(pool->counters, puts, n - done);
+    _pool_add_bulk(pool, objs + done, n - done);
+    pthread_mutex_unlock(&depot->lock);
+    return 0;
+}
+
+static inline void *_lf_ptr(u64 top)
+{
+    return (void *)(uintptr_t)(top & LF_PTR_MASK);
+}
+
+static inline u64 _lf_top(void *link, u64 prev)
+{
+    return (uintptr_t)link | ((prev >> LF_PTR_BITS) + 1) << LF_PTR_BITS;
+}
+
+/**
+ * _lf_push - push a chain of links on a lock-free pool stack.
+ * @pool:    The pool address.
+ * @first:   The first link of chain.
+ * @last:    The last link of chain.
+ */
+static void _lf_push(pool_t *pool, void *first, void *last)
+{
+    u64 *top = &pool->lf->top, old = __atomic_load_n(top, __ATOMIC_RELAXED);
+
+    do {
+        *(void **)last = _lf_ptr(old);
+    } while (!__atomic_compare_exchange_n(top, &old, _lf_top(first, old), true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/**
+ * _lf_pop - pop a link from a lock-free pool stack.
+ * @pool:    The pool address.
+ *
+ * The popped link next pointer may be read after the link was popped by
+ * another thread, and be garbage: the compare-and-swap will then fail, as the
+ * top tag has changed. Blocks are never released, so the read is safe.
+ *
+ * Return:   The link, or NULL if stack is empty.
+ */
+static void *_lf_pop(pool_t *pool)
+{
+    u64 *top = &pool->lf->top, old = __atomic_load_n(top, __ATOMIC_ACQUIRE);
+    void *link, *next;
+
+    do {
+        if (!(link = _lf_ptr(old)))
+            return NULL;
+        next = __atomic_load_n((void **)link, __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(top, &old, _lf_top(next, old), true,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+    return link;
+}
+
+/**
+ * _pool_lf_refill - carve a block into a lock-free pool stack.
+ * @pool:    The pool address.
+ *
+ * Under grow lock, if stack is still empty, all remaining objects of last
+ * block (or of a new block) are carved, chained, and pushed at once.
+ *
+ * Return:   0 if success, -1 otherwise.
+ */
+static int _pool_lf_refill(pool_t *pool)
+{
+    int res = 0;
+
+    pthread_mutex_lock(&pool->lf->lock);
+    if (!_lf_ptr(__atomic_load_n(&pool->lf->top, __ATOMIC_ACQUIRE))) {
+        if (pool->uncarved || !(res = _pool_grow(pool))) {
+            void *first = _obj_link(pool, pool->carve), *link = first;
+
+            for (u32 i = 0; i < pool->uncarved; ++i, pool->carve += pool->eltsize) {
+                if (pool->ctor)
+                    pool->ctor(pool->carve);
+                link = _obj_link(pool, pool->carve);
+                *(void **)link = (char *)link + pool->eltsize;
+            }
+            pool->available -= pool->uncarved;
+            pool->uncarved = 0;
+            _lf_push(pool, first, link);
         }
     }
-    /* this is the effective address of the object (and also the
-     * pool list_head address)
+    pthread_mutex_unlock(&pool->lf->lock);
+    return res;
+}
+
+static void *_pool_lf_get(pool_t *pool)
+{
+    void *link;
+
+    while (!(link = _lf_pop(pool)))
+        if (_pool_lf_refill(pool))
+            return NULL;
+    STAT_ADD_SHARED(pool->counters, gets, 1);
+    STAT_HIWATER_SHARED(pool);
+    return _link_obj(pool, link);
+}
+
+static u32 _pool_lf_get_bulk(pool_t *pool, void **objs, u32 n)
+{
+    u32 done;
+
+    for (done = 0; done < n; ++done)
+        if (!(objs[done] = _pool_lf_get(pool)))
+            break;
+    return done;
+}
+
+static u32 _pool_lf_add_bulk(pool_t *pool, void **objs, u32 n)
+{
+    if (n) {
+        for (u32 i = 0; i < n - 1; ++i)
+            *(void **)_obj_link(pool, objs[i]) = _obj_link(pool, objs[i + 1]);
+        _lf_push(pool, _obj_link(pool, objs[0]), _obj_link(pool, objs[n - 1]));
+        STAT_ADD_SHARED(pool->counters, puts, n);
+    }
+    return 0;
+}
+
+u32 pool_add(pool_t *pool, void *elt)
+{
+    HARDEN_PUT(pool, elt);
+    if (pool->lf) {
+        void *link = _obj_link(pool, elt);
+        _lf_push(pool, link, link);
+        STAT_ADD_SHARED(pool->counters, puts, 1);
+        return 0;
+    }
+    if (pool->depot)
+        return _pool_mt_add(pool, elt);
+    STAT_ADD(pool->counters, puts, 1);
+    return _pool_add(pool, elt);
+}
+
+u32 pool_add_bulk(pool_t *pool, void **objs, u32 n)
+{
+#   ifdef POOL_HARDEN
+    for (u32 i = 0; i < n; ++i)
+        HARDEN_PUT(pool, objs[i]);
+#   endif
+    if (pool->lf)
+        return _pool_lf_add_bulk(pool, objs, n);
+    if (pool->depot)
+        return _pool_mt_add_bulk(pool, objs, n);
+    STAT_ADD(pool->counters, puts, n);
+    return _pool_add_bulk(pool, objs, n);
+}
+
+#ifdef POOL_STATS_LATENCY
+/* pool_get() latency histogram: thread cache one for POOL_MT pools.
+ */
+static void _stat_latency(pool_t *pool, u64 ns)
+{
+    pool_counters_t *counters = pool->counters;
+    uint bucket = min(fls64(ns), POOL_LATENCY_BUCKETS - 1);
+
+    if (pool->depot) {
+        pool_tcache_t *tcache = pthread_getspecific(pool->depot->key);
+        if (!tcache)
+            return;
+        counters = &tcache->counters;
+    } else if (pool->lf) {
+        STAT_ADD_SHARED(counters, latency[bucket], 1);
+        return;
+    }
+    STAT_ADD(counters, latency[bucket], 1);
+}
+#endif
+
+void *pool_get(pool_t *pool)
+{
+    void *res;
+#   ifdef POOL_STATS_LATENCY
+    u64 start = _stat_ns();
+#   endif
+
+    if (!pool)
+        return NULL;
+    if (pool->lf) {
+        res = _pool_lf_get(pool);
+    } else if (pool->depot) {
+        res = _pool_mt_get(pool);
+    } else if ((res = _pool_alloc(pool))) {
+        STAT_ADD(pool->counters, gets, 1);
+    }
+#   ifdef POOL_STATS_LATENCY
+    if (res)
+        _stat_latency(pool, _stat_ns() - start);
+#   endif
+    if (res)
+        HARDEN_GET(pool, res);
+    return res;
+}
+
+u32 pool_get_bulk(pool_t *pool, void **objs, u32 n)
+{
+    u32 res;
+
+    if (!pool)
+        return 0;
+    if (pool->lf) {
+        res = _pool_lf_get_bulk(pool, objs, n);
+    } else if (pool->depot) {
+        res = _pool_mt_get_bulk(pool, objs, n);
+    } else {
+        res = _pool_alloc_bulk(pool, objs, n);
+        STAT_ADD(pool->counters, gets, res);
+    }
+#   ifdef POOL_HARDEN
+    for (u32 i = 0; i < res; ++i)
+        HARDEN_GET(pool, objs[i]);
+#   endif
+    return res;
+}
+
+int pool_counters(__unused pool_t *pool, pool_counters_t *counters)
+{
+#   ifdef POOL_STATS
+    pool_tcache_t *tcache;
+
+    if (!pool) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (pool->depot)
+        pthread_mutex_lock(&pool->depot->lock);
+    *counters = *pool->counters;
+    if (pool->depot) {
+        list_for_each_entry(tcache, &pool->depot->list_tcaches, list) {
+            counters->gets += _stat_read(&tcache->counters.gets);
+            counters->puts += _stat_read(&tcache->counters.puts);
+            for (int i = 0; i < POOL_LATENCY_BUCKETS; ++i)
+                counters->latency[i] += _stat_read(&tcache->counters.latency[i]);
+        }
+        pthread_mutex_unlock(&pool->depot->lock);
+    }
+    counters->inuse = counters->gets - counters->puts;
+    return 0;
+#   else
+    memset(counters, 0, sizeof(*counters));
+    errno = ENOTSUP;
+    return -1;
+#   endif
+}
+
+size_t pool_trim(pool_t *pool, u32 keep)
+{
+    struct pool_depot *depot;
+    pool_mag_t *mag;
+    size_t res;
+
+    if (!pool || !(pool->flags & POOL_RECLAIM))
+        return 0;
+    if (!(depot = pool->depot))
+        return _pool_trim(pool, keep);
+
+    /* objects in depot full magazines are given back to pool
+     */
+    pthread_mutex_lock(&depot->lock);
+    while ((mag = depot->full)) {
+        depot->full = mag->next;
+        depot->nfull--;
+        _pool_add_bulk(pool, mag->objs, mag->count);
+        mag->count = 0;
+        mag->next = depot->empty;
+        depot->empty = mag;
+        depot->nempty++;
+    }
+    res = _pool_trim(pool, keep);
+    pthread_mutex_unlock(&depot->lock);
+    return res;
+}
+
+static void _depot_destroy(pool_t *pool)
+{
+    struct pool_depot *depot = pool->depot;
+    pool_tcache_t *tcache, *tmp;
+    pool_mag_t *mag;
+
+    /* no more destructor calls after key deletion
      */
-    return _pool_get(pool);
+    pthread_key_delete(depot->key);
+    list_for_each_entry_safe(tcache, tmp, &depot->list_tcaches, list) {
+        free(tcache->loaded);
+        free(tcache->prev);
+        list_del(&tcache->list);
+        free(tcache);
+    }
+    while ((mag = depot->full)) {
+        depot->full = mag->next;
+        free(mag);
+    }
+    while ((mag = depot->empty)) {
+        depot->empty = mag->next;
+        free(mag);
+    }
+    pthread_mutex_destroy(&depot->lock);
+    free(depot);
 }
 
 void pool_destroy(pool_t *pool)
@@ -144,6 +1600,12 @@ void pool_destroy(pool_t *pool)
     block_t *block, *tmp;
     if (!pool)
         return;
+    if (pool->depot)
+        _depot_destroy(pool);
+    if (pool->lf) {
+        pthread_mutex_destroy(&pool->lf->lock);
+        free(pool->lf);
+    }
     /* release memory blocks */
 #   ifdef DEBUG_POOL
     log_f(1, "[%s]: releasing %d blocks and main structure\n", pool->name, pool->nblocks);
@@ -154,10 +1616,13 @@ void pool_destroy(pool_t *pool)
         log(5, " %p", block);
 #       endif
         list_del(&block->list_blocks);
-        free(block);
+        if (pool->dtor)
+            _block_dtor(pool, block, pool->uncarved? pool->carve: NULL);
+        _block_free(pool, block);
     }
 #   ifdef DEBUG_POOL
     log(5, "\n");
 #   endif
+    free(pool->counters);
     free(pool);
 }
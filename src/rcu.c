@@ -0,0 +1,134 @@
+/* rcu.c - userspace read-copy-update.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "brlib.h"
+#include "list.h"
+#include "bug.h"
+#include "rcu.h"
+
+__thread struct rcu_reader *rcu_reader;
+u64 rcu_gp_ctr = 1;
+
+static pthread_mutex_t gp_lock = PTHREAD_MUTEX_INITIALIZER; /* readers & gp */
+static LIST_HEAD(readers);
+
+static pthread_mutex_t cb_lock = PTHREAD_MUTEX_INITIALIZER; /* callbacks */
+static struct rcu_head *cb_list;
+static u32 cb_count;
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t key;
+
+static void _rcu_unregister(void *arg)
+{
+    struct rcu_reader *reader = arg;
+
+    pthread_mutex_lock(&gp_lock);
+    list_del(&reader->list);
+    pthread_mutex_unlock(&gp_lock);
+    free(reader);
+}
+
+static void _key_create(void)
+{
+    pthread_key_create(&key, _rcu_unregister);
+}
+
+struct rcu_reader *__rcu_register(void)
+{
+    struct rcu_reader *reader;
+
+    if (posix_memalign((void **)&reader, sizeof(*reader), sizeof(*reader)))
+        bug_on_always(1);
+    reader->ctr = 0;
+    reader->nesting = 0;
+    pthread_once(&key_once, _key_create);
+    pthread_setspecific(key, reader);
+    pthread_mutex_lock(&gp_lock);
+    list_add(&reader->list, &readers);
+    pthread_mutex_unlock(&gp_lock);
+    rcu_reader = reader;
+    return reader;
+}
+
+/* wait while a reader slot is older than @ctr. Grace periods are rare and
+ * we may run on fewer CPUs than threads: yield instead of spinning.
+ */
+static void _wait_reader(struct rcu_reader *reader, u64 ctr)
+{
+    u64 cur;
+
+    while ((cur = __atomic_load_n(&reader->ctr, __ATOMIC_ACQUIRE)) && cur < ctr)
+        sched_yield();
+}
+
+void synchronize_rcu(void)
+{
+    struct rcu_reader *reader;
+    u64 ctr;
+
+    bug_on(rcu_reader && rcu_reader->nesting);
+    pthread_mutex_lock(&gp_lock);
+    /* full barrier: removals are visible before counter update, and counter
+     * update before readers slots are read.
+     */
+    ctr = __atomic_add_fetch(&rcu_gp_ctr, 1, __ATOMIC_SEQ_CST);
+    list_for_each_entry(reader, &readers, list)
+        _wait_reader(reader, ctr);
+    pthread_mutex_unlock(&gp_lock);
+}
+
+static void _run_callbacks(struct rcu_head *head)
+{
+    struct rcu_head *next;
+
+    synchronize_rcu();
+    for (; head; head = next) {
+        next = head->next;
+        head->func(head);
+    }
+}
+
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head))
+{
+    struct rcu_head *batch = NULL;
+
+    head->func = func;
+    pthread_mutex_lock(&cb_lock);
+    head->next = cb_list;
+    cb_list = head;
+    if (++cb_count >= RCU_BATCH) {
+        batch = cb_list;
+        cb_list = NULL;
+        cb_count = 0;
+    }
+    pthread_mutex_unlock(&cb_lock);
+    if (batch)
+        _run_callbacks(batch);
+}
+
+void rcu_barrier(void)
+{
+    struct rcu_head *batch;
+
+    pthread_mutex_lock(&cb_lock);
+    batch = cb_list;
+    cb_list = NULL;
+    cb_count = 0;
+    pthread_mutex_unlock(&cb_lock);
+    _run_callbacks(batch);
+}
@@ -0,0 +1,303 @@
+/* shtable.c - sharded concurrent hashtables.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "brlib.h"
+#include "list.h"
+#include "hash.h"
+#include "rculist.h"
+#include "seqlock.h"
+#include "debug.h"
+#include "shtable.h"
+
+#ifdef SHTABLE_STATS
+#define STAT_INC(shard, counter) __atomic_add_fetch(&(shard)->counter, 1, __ATOMIC_RELAXED)
+#else
+#define STAT_INC(shard, counter) do { } while (0)
+#endif
+
+/* key hash selects shard (high bits) and bucket (low bits).
+ */
+static inline struct shtable_shard *_shard(shtable_t *t, u64 key,
+                                           struct hlist_head **bucket)
+{
+    u32 hash = hash_64(key, t->shardbits + t->bucketbits);
+    struct shtable_shard *shard = t->shards + (hash >> t->bucketbits);
+
+    *bucket = shard->buckets + (hash & ((1U << t->bucketbits) - 1));
+    return shard;
+}
+
+static inline void _write_lock(shtable_t *t, struct shtable_shard *shard)
+{
+    if (t->flags & SHTABLE_SEQLOCK)
+        write_seqlock(&shard->seqlock);
+    else
+        pthread_rwlock_wrlock(&shard->rwlock);
+}
+
+static inline void _write_unlock(shtable_t *t, struct shtable_shard *shard)
+{
+    if (t->flags & SHTABLE_SEQLOCK)
+        write_sequnlock(&shard->seqlock);
+    else
+        pthread_rwlock_unlock(&shard->rwlock);
+}
+
+/* exclude writers, but not readers.
+ */
+static inline void _read_lock(shtable_t *t, struct shtable_shard *shard)
+{
+    if (t->flags & SHTABLE_SEQLOCK)
+        read_seqlock_excl(&shard->seqlock);
+    else
+        pthread_rwlock_rdlock(&shard->rwlock);
+}
+
+static inline void _read_unlock(shtable_t *t, struct shtable_shard *shard)
+{
+    if (t->flags & SHTABLE_SEQLOCK)
+        read_sequnlock_excl(&shard->seqlock);
+    else
+        pthread_rwlock_unlock(&shard->rwlock);
+}
+
+static inline struct hlist_node *_find(shtable_t *t, struct hlist_head *bucket, u64 key)
+{
+    struct hlist_node *node;
+
+    for (node = rcu_dereference(hlist_first_rcu(bucket)); node;
+         node = rcu_dereference(hlist_next_rcu(node)))
+        if (t->key(node) == key)
+            return node;
+    return NULL;
+}
+
+/* destroy the @n first shards locks and buckets, and free @t.
+ */
+static void _destroy_shards(shtable_t *t, u32 n)
+{
+    for (u32 i = 0; i < n; ++i) {
+        struct shtable_shard *shard = t->shards + i;
+
+        if (t->flags & SHTABLE_SEQLOCK)
+            seqlock_destroy(&shard->seqlock);
+        else
+            pthread_rwlock_destroy(&shard->rwlock);
+        free(shard->buckets);
+    }
+    free(t->shards);
+    free(t);
+}
+
+shtable_t *shtable_create(u32 shardbits, u32 bucketbits, u32 flags,
+                          u64 (*key)(const struct hlist_node *node))
+{
+    u64 bits = (u64) shardbits + bucketbits;
+    u32 nshards;
+    shtable_t *t;
+    int err;
+
+    if (!bits || bits > SHTABLE_MAX_BITS || shardbits > 31 || bucketbits > 31) {
+        errno = EINVAL;
+        return NULL;
+    }
+    nshards = 1U << shardbits;
+    if (!(t = malloc(sizeof(*t))))
+        goto err_nomem;
+    if (posix_memalign((void **)&t->shards, 64, nshards * sizeof(*t->shards))) {
+        free(t);
+        goto err_nomem;
+    }
+    t->flags = flags;
+    t->shardbits = shardbits;
+    t->bucketbits = bucketbits;
+    t->key = key;
+    for (u32 i = 0; i < nshards; ++i) {
+        struct shtable_shard *shard = t->shards + i;
+
+        *shard = (struct shtable_shard) { 0 };
+        if (!(shard->buckets = calloc(1U << bucketbits, sizeof(struct hlist_head)))) {
+            _destroy_shards(t, i);
+            goto err_nomem;
+        }
+        if (flags & SHTABLE_SEQLOCK)
+            err = seqlock_init(&shard->seqlock);
+        else
+            err = pthread_rwlock_init(&shard->rwlock, NULL);
+        if (err) {
+            free(shard->buckets);
+            _destroy_shards(t, i);
+            errno = err;
+            return NULL;
+        }
+    }
+    return t;
+err_nomem:
+    errno = ENOMEM;
+    return NULL;
+}
+
+struct hlist_node *shtable_add(shtable_t *t, struct hlist_node *node)
+{
+    struct hlist_head *bucket;
+    u64 key = t->key(node);
+    struct shtable_shard *shard = _shard(t, key, &bucket);
+    struct hlist_node *old;
+
+    _write_lock(t, shard);
+    if (!(old = _find(t, bucket, key))) {
+        hlist_add_head_rcu(node, bucket);
+        shard->count++;
+        STAT_INC(shard, inserts);
+    }
+    _write_unlock(t, shard);
+    return old;
+}
+
+struct hlist_node *shtable_del(shtable_t *t, u64 key)
+{
+    struct hlist_head *bucket;
+    struct shtable_shard *shard = _shard(t, key, &bucket);
+    struct hlist_node *node;
+
+    _write_lock(t, shard);
+    if ((node = _find(t, bucket, key))) {
+        hlist_del_rcu(node);
+        shard->count--;
+        STAT_INC(shard, deletes);
+    }
+    _write_unlock(t, shard);
+    return node;
+}
+
+bool shtable_lookup(shtable_t *t, u64 key,
+                    void (*fn)(struct hlist_node *node, void *arg), void *arg)
+{
+    struct hlist_head *bucket;
+    struct shtable_shard *shard = _shard(t, key, &bucket);
+    struct hlist_node *node;
+
+    STAT_INC(shard, lookups);
+    if (t->flags & SHTABLE_SEQLOCK) {
+        u32 seq;
+
+        rcu_read_lock();
+        do {
+            seq = read_seqbegin(&shard->seqlock);
+            if ((node = _find(t, bucket, key)) && fn)
+                fn(node, arg);
+        } while (read_seqretry(&shard->seqlock, seq));
+        rcu_read_unlock();
+    } else {
+        pthread_rwlock_rdlock(&shard->rwlock);
+        if ((node = _find(t, bucket, key)) && fn)
+            fn(node, arg);
+        pthread_rwlock_unlock(&shard->rwlock);
+    }
+    if (node)
+        STAT_INC(shard, hits);
+    return node;
+}
+
+bool shtable_update(shtable_t *t, u64 key,
+                    void (*fn)(struct hlist_node *node, void *arg), void *arg)
+{
+    struct hlist_head *bucket;
+    struct shtable_shard *shard = _shard(t, key, &bucket);
+    struct hlist_node *node;
+
+    _write_lock(t, shard);
+    if ((node = _find(t, bucket, key)))
+        fn(node, arg);
+    _write_unlock(t, shard);
+    return node;
+}
+
+void shtable_shard_stats(shtable_t *t, u32 n, shtable_stats_t *stats)
+{
+    struct shtable_shard *shard = t->shards + n;
+    u32 nbuckets = 1U << t->bucketbits;
+
+    *stats = (shtable_stats_t) { .buckets = nbuckets };
+    _read_lock(t, shard);
+    stats->count = shard->count;
+    for (u32 b = 0; b < nbuckets; ++b) {
+        struct hlist_node *node;
+        u64 len = 0;
+
+        hlist_for_each(node, shard->buckets + b)
+            len++;
+        if (len)
+            stats->used++;
+        stats->maxchain = max(stats->maxchain, len);
+    }
+    _read_unlock(t, shard);
+#   ifdef SHTABLE_STATS
+    stats->lookups = __atomic_load_n(&shard->lookups, __ATOMIC_RELAXED);
+    stats->hits = __atomic_load_n(&shard->hits, __ATOMIC_RELAXED);
+    stats->inserts = __atomic_load_n(&shard->inserts, __ATOMIC_RELAXED);
+    stats->deletes = __atomic_load_n(&shard->deletes, __ATOMIC_RELAXED);
+#   endif
+}
+
+void shtable_stats(shtable_t *t)
+{
+    u32 nshards = 1U << t->shardbits;
+    shtable_stats_t stats, total = { 0 };
+
+    for (u32 i = 0; i < nshards; ++i) {
+        shtable_shard_stats(t, i, &stats);
+        log_f(2, "shard %u: count:%llu used:%llu/%llu avgchain:%.2f maxchain:%llu "
+              "lookups:%llu hits:%llu inserts:%llu deletes:%llu\n", i,
+              (ullong) stats.count, (ullong) stats.used, (ullong) stats.buckets,
+              stats.used? (double) stats.count / stats.used: 0.0,
+              (ullong) stats.maxchain, (ullong) stats.lookups, (ullong) stats.hits,
+              (ullong) stats.inserts, (ullong) stats.deletes);
+        total.count += stats.count;
+        total.buckets += stats.buckets;
+        total.used += stats.used;
+        total.maxchain = max(total.maxchain, stats.maxchain);
+        total.lookups += stats.lookups;
+        total.hits += stats.hits;
+        total.inserts += stats.inserts;
+        total.deletes += stats.deletes;
+    }
+    log_f(1, "shtable [%p]: shards:%u %s count:%llu used:%llu/%llu avgchain:%.2f "
+          "maxchain:%llu lookups:%llu hits:%llu inserts:%llu deletes:%llu\n",
+          (void *)t, nshards, t->flags & SHTABLE_SEQLOCK? "seqlock": "rwlock",
+          (ullong) total.count, (ullong) total.used, (ullong) total.buckets,
+          total.used? (double) total.count / total.used: 0.0,
+          (ullong) total.maxchain, (ullong) total.lookups, (ullong) total.hits,
+          (ullong) total.inserts, (ullong) total.deletes);
+}
+
+void shtable_destroy(shtable_t *t, void (*fn)(struct hlist_node *node))
+{
+    u32 nshards = 1U << t->shardbits;
+
+    if (fn) {
+        for (u32 i = 0; i < nshards; ++i) {
+            for (u32 b = 0; b < 1U << t->bucketbits; ++b) {
+                struct hlist_node *node, *tmp;
+
+                hlist_for_each_safe(node, tmp, t->shards[i].buckets + b)
+                    fn(node);
+            }
+        }
+    }
+    _destroy_shards(t, nshards);
+}
@@ -0,0 +1,333 @@
+/* swiss.c - open-addressing SIMD hashtables.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__SSE2__)
+#  include <immintrin.h>
+#endif
+
+#include "brlib.h"
+#include "bitops.h"
+#include "likely.h"
+#include "swiss.h"
+
+/* maximum load: 7/8 */
+#define MAX_LOAD(capacity) ((capacity) - (capacity) / 8)
+
+/* Group matching: return a bitmask of group slots whose control byte is
+ * @h2, is empty, or is empty or deleted (i.e. has its high bit set).
+ */
+#if defined(__AVX2__)
+static inline u32 _match(const s8 *ctrl, s8 h2)
+{
+    __m256i group = _mm256_load_si256((const __m256i *)ctrl);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8(h2)));
+}
+
+static inline u32 _match_empty(const s8 *ctrl)
+{
+    return _match(ctrl, SWISS_EMPTY);
+}
+
+static inline u32 _match_free(const s8 *ctrl)
+{
+    return _mm256_movemask_epi8(_mm256_load_si256((const __m256i *)ctrl));
+}
+#elif defined(__SSE2__)
+static inline u32 _match(const s8 *ctrl, s8 h2)
+{
+    __m128i group = _mm_load_si128((const __m128i *)ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+}
+
+static inline u32 _match_empty(const s8 *ctrl)
+{
+    return _match(ctrl, SWISS_EMPTY);
+}
+
+static inline u32 _match_free(const s8 *ctrl)
+{
+    return _mm_movemask_epi8(_mm_load_si128((const __m128i *)ctrl));
+}
+#else
+static inline u32 _match(const s8 *ctrl, s8 h2)
+{
+    u32 mask = 0;
+
+    for (int i = 0; i < SWISS_GROUP; ++i)
+        mask |= (u32) (ctrl[i] == h2) << i;
+    return mask;
+}
+
+static inline u32 _match_empty(const s8 *ctrl)
+{
+    return _match(ctrl, SWISS_EMPTY);
+}
+
+static inline u32 _match_free(const s8 *ctrl)
+{
+    u32 mask = 0;
+
+    for (int i = 0; i < SWISS_GROUP; ++i)
+        mask |= (u32) (ctrl[i] < 0) << i;
+    return mask;
+}
+#endif
+
+/* default hash: words are mixed with a multiply and xor-shift (murmur3
+ * finalizer). 7 lowest bits are the control byte, next ones select the group.
+ */
+static inline u64 _mix(u64 h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static u64 _hash_bytes(const void *key, size_t size)
+{
+    const char *p = key;
+    u64 h = size, w;
+
+    for (; size >= 8; size -= 8, p += 8) {
+        memcpy(&w, p, 8);
+        h = _mix(h ^ w) * 0x9E3779B97F4A7C15ULL;
+    }
+    if (size) {
+        w = 0;
+        memcpy(&w, p, size);
+        h = _mix(h ^ w) * 0x9E3779B97F4A7C15ULL;
+    }
+    return _mix(h);
+}
+
+static inline u64 _hash(const swiss_t *t, const void *key)
+{
+    if (t->hash)
+        return t->hash(key, t->keysize);
+    if (t->keysize == 8) {
+        u64 k;
+        memcpy(&k, key, 8);
+        return _mix(k * 0x9E3779B97F4A7C15ULL);
+    }
+    return _hash_bytes(key, t->keysize);
+}
+
+static inline bool _eq(const swiss_t *t, const void *k1, const void *k2)
+{
+    if (t->eq)
+        return t->eq(k1, k2, t->keysize);
+    if (t->keysize == 8) {                        /* keys may be unaligned */
+        u64 a, b;
+        memcpy(&a, k1, 8);
+        memcpy(&b, k2, 8);
+        return a == b;
+    }
+    return !memcmp(k1, k2, t->keysize);
+}
+
+static inline char *_slot(const swiss_t *t, u64 i)
+{
+    return t->slots + i * t->slotsize;
+}
+
+static inline s8 _h2(u64 hash)
+{
+    return hash & 0x7f;
+}
+
+/* allocate control bytes & slots for @capacity slots, all empty.
+ */
+static int _alloc(swiss_t *t, u64 capacity)
+{
+    size_t ctrlsize = ALIGN(capacity, 64);
+    void *mem;
+
+    if (posix_memalign(&mem, 64, ctrlsize + capacity * t->slotsize)) {
+        errno = ENOMEM;
+        return -1;
+    }
+    t->ctrl = mem;
+    t->slots = (char *)mem + ctrlsize;
+    memset(t->ctrl, SWISS_EMPTY, capacity);
+    t->capacity = capacity;
+    t->groupmask = capacity / SWISS_GROUP - 1;
+    t->growth = MAX_LOAD(capacity) - t->count;
+    return 0;
+}
+
+/* find a free slot for @hash. There must be one.
+ */
+static u64 _find_free(const swiss_t *t, u64 hash)
+{
+    u64 group = (hash >> 7) & t->groupmask;
+
+    for (u64 probe = 1; ; group = (group + probe++) & t->groupmask) {
+        u64 base = group * SWISS_GROUP;
+        u32 mask = _match_free(t->ctrl + base);
+
+        if (mask)
+            return base + ctz32(mask);
+    }
+}
+
+/* find @key slot, or -1.
+ */
+static s64 _find(const swiss_t *t, const void *key, u64 hash)
+{
+    u64 group = (hash >> 7) & t->groupmask;
+    s8 h2 = _h2(hash);
+
+    for (u64 probe = 1; probe <= t->groupmask + 1; group = (group + probe++) & t->groupmask) {
+        u64 base = group * SWISS_GROUP;
+        const s8 *ctrl = t->ctrl + base;
+        u32 mask = _match(ctrl, h2);
+
+        for (; mask; mask &= mask - 1) {          /* no ctz32(0) */
+            int pos = ctz32(mask);
+
+            if (likely(_eq(t, _slot(t, base + pos), key)))
+                return base + pos;
+        }
+        if (likely(_match_empty(ctrl)))
+            break;
+    }
+    return -1;
+}
+
+/* rehash to @capacity slots. With same capacity, deleted slots are
+ * reclaimed.
+ */
+static int _resize(swiss_t *t, u64 capacity)
+{
+    s8 *oldctrl = t->ctrl;
+    char *oldslots = t->slots;
+    u64 oldcapacity = t->capacity;
+
+    if (_alloc(t, capacity))
+        return -1;
+    for (u64 i = 0; i < oldcapacity; ++i) {
+        if (oldctrl[i] >= 0) {
+            char *slot = oldslots + i * t->slotsize;
+            u64 hash = _hash(t, slot), dst = _find_free(t, hash);
+
+            t->ctrl[dst] = _h2(hash);
+            memcpy(_slot(t, dst), slot, t->slotsize);
+        }
+    }
+    free(oldctrl);
+    return 0;
+}
+
+swiss_t *swiss_create(size_t keysize, size_t valsize, u64 hint,
+                      u64 (*hash)(const void *key, size_t size),
+                      bool (*eq)(const void *k1, const void *k2, size_t size))
+{
+    swiss_t *t;
+    u64 capacity = SWISS_GROUP;
+
+    if (!(t = malloc(sizeof(*t)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    t->keysize = keysize;
+    t->valsize = valsize;
+    t->valoff = ALIGN(keysize, 8);
+    t->slotsize = ALIGN(t->valoff + valsize, 8);
+    t->count = 0;
+    t->hash = hash;
+    t->eq = eq;
+    while (MAX_LOAD(capacity) < hint)
+        capacity *= 2;
+    if (_alloc(t, capacity)) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+void *swiss_get(swiss_t *t, const void *key)
+{
+    s64 i = _find(t, key, _hash(t, key));
+
+    return i < 0? NULL: _slot(t, i) + t->valoff;
+}
+
+void *swiss_put(swiss_t *t, const void *key, const void *val)
+{
+    u64 hash = _hash(t, key);
+    s64 i = _find(t, key, hash);
+    char *slot;
+
+    if (i < 0) {
+        if (unlikely(!t->growth)) {
+            /* grow, unless many slots are deleted ones */
+            u64 capacity = t->count < MAX_LOAD(t->capacity) / 2?
+                t->capacity: t->capacity * 2;
+            if (_resize(t, capacity))
+                return NULL;
+        }
+        i = _find_free(t, hash);
+        if (t->ctrl[i] == SWISS_EMPTY)
+            t->growth--;
+        t->ctrl[i] = _h2(hash);
+        t->count++;
+        memcpy(_slot(t, i), key, t->keysize);
+    }
+    slot = _slot(t, i) + t->valoff;
+    if (val)
+        memcpy(slot, val, t->valsize);
+    return slot;
+}
+
+bool swiss_del(swiss_t *t, const void *key)
+{
+    s64 i = _find(t, key, _hash(t, key));
+
+    if (i < 0)
+        return false;
+    /* if the slot group has an empty slot, no probe sequence went past it:
+     * the slot may become empty instead of deleted.
+     */
+    if (_match_empty(t->ctrl + (i & ~(SWISS_GROUP - 1)))) {
+        t->ctrl[i] = SWISS_EMPTY;
+        t->growth++;
+    } else {
+        t->ctrl[i] = SWISS_DELETED;
+    }
+    t->count--;
+    return true;
+}
+
+void *swiss_next(swiss_t *t, u64 *pos, void **key)
+{
+    for (; *pos < t->capacity; ++*pos) {
+        if (t->ctrl[*pos] >= 0) {
+            char *slot = _slot(t, (*pos)++);
+            if (key)
+                *key = slot;
+            return slot + t->valoff;
+        }
+    }
+    return NULL;
+}
+
+void swiss_destroy(swiss_t *t)
+{
+    free(t->ctrl);
+    free(t);
+}
@@ -0,0 +1,120 @@
+/* ulist.c - unrolled (chunked) lists.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "brlib.h"
+#include "list.h"
+#include "ulist.h"
+
+void ulist_init(struct ulist_head *head, size_t eltsize)
+{
+    size_t room = ULIST_NODE_SIZE - offsetof(struct ulist_node, data);
+
+    INIT_LIST_HEAD(&head->nodes);
+    head->objsize = eltsize;
+    head->eltsize = ALIGN(eltsize, 8);
+    head->pernode = max(room / head->eltsize, (size_t) 1);
+    head->count = 0;
+}
+
+static struct ulist_node *_node_alloc(struct ulist_head *head)
+{
+    struct ulist_node *node;
+    size_t size = offsetof(struct ulist_node, data) + head->pernode * head->eltsize;
+
+    if (posix_memalign((void **)&node, 64, size)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    node->count = 0;
+    return node;
+}
+
+void *ulist_add(struct ulist_head *head, const void *elt)
+{
+    struct ulist_node *node = NULL;
+    void *res;
+
+    if (!list_empty(&head->nodes))
+        node = list_first_entry(&head->nodes, struct ulist_node, list);
+    if (!node || node->count == head->pernode) {
+        if (!(node = _node_alloc(head)))
+            return NULL;
+        list_add(&node->list, &head->nodes);
+    }
+    res = node->data;
+    memmove(node->data + head->eltsize, node->data, node->count * head->eltsize);
+    if (elt)
+        memcpy(res, elt, head->objsize);
+    node->count++;
+    head->count++;
+    return res;
+}
+
+void *ulist_add_tail(struct ulist_head *head, const void *elt)
+{
+    struct ulist_node *node = NULL;
+    void *res;
+
+    if (!list_empty(&head->nodes))
+        node = list_last_entry(&head->nodes, struct ulist_node, list);
+    if (!node || node->count == head->pernode) {
+        if (!(node = _node_alloc(head)))
+            return NULL;
+        list_add_tail(&node->list, &head->nodes);
+    }
+    res = node->data + node->count * head->eltsize;
+    if (elt)
+        memcpy(res, elt, head->objsize);
+    node->count++;
+    head->count++;
+    return res;
+}
+
+void ulist_del(struct ulist_iter *iter)
+{
+    struct ulist_head *head = iter->head;
+    struct ulist_node *node = iter->node;
+    char *elt = node->data + iter->idx * head->eltsize;
+
+    node->count--;
+    head->count--;
+    if (!node->count) {
+        /* next ulist_next() will enter next node. Previous node may be
+         * the list head: only its list field is valid.
+         */
+        iter->node = list_entry(node->list.prev, struct ulist_node, list);
+        iter->idx = iter->count = 0;
+        list_del(&node->list);
+        free(node);
+        return;
+    }
+    memmove(elt, elt + head->eltsize, (node->count - iter->idx) * head->eltsize);
+    /* next ulist_next() will return the moved element */
+    iter->idx--;
+    iter->count--;
+}
+
+void ulist_free(struct ulist_head *head)
+{
+    struct ulist_node *node, *tmp;
+
+    list_for_each_entry_safe(node, tmp, &head->nodes, list) {
+        list_del(&node->list);
+        free(node);
+    }
+    head->count = 0;
+}
@@ -0,0 +1,57 @@
+/* bench.h - small helpers for brlib benchmarks.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ */
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <time.h>
+
+#include "brlib.h"
+
+/**
+ * bench_ns - monotonic clock, in nanoseconds.
+ */
+static inline s64 bench_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * bench_rand - xorshift64* pseudo-random generator.
+ * @state: generator state, must be non-zero.
+ */
+static inline u64 bench_rand(u64 *state)
+{
+    u64 x = *state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * bench_mops - million operations per second.
+ * @ops: number of operations.
+ * @ns:  elapsed time, in nanoseconds.
+ */
+static inline double bench_mops(u64 ops, s64 ns)
+{
+    return ns? (double) ops * 1000.0 / ns: 0.0;
+}
+
+#endif  /* _BENCH_H */
@@ -0,0 +1,194 @@
+/* brmalloc-bench.c - br_malloc() vs glibc malloc() benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: brmalloc-bench [-o ops] [-w window] [-s maxsize]
+ *
+ * classes: check size classes lookup and usable size, and large objects.
+ *   Objects data must not be taken for a large object header.
+ * blocks:  check objects filling several blocks (with POOL_HARDEN too).
+ * churn:   randomly allocate/free objects of random sizes (8 to @maxsize) in a
+ *          window of @window slots, @ops times.
+ * batch:   allocate @window objects of random sizes, then free them all,
+ *          until @ops allocations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "brmalloc.h"
+#include "bench.h"
+
+static const struct allocator {
+    char *name;
+    void *(*alloc)(size_t);
+    void (*free)(void *);
+} allocators[] = {
+    { "malloc",    malloc,    free },
+    { "br_malloc", br_malloc, br_free },
+};
+
+static void check_classes(void)
+{
+    for (size_t size = 1; size <= BRMALLOC_MAX_SIZE; ++size) {
+        uint class = brmalloc_class(size);
+        size_t csize = brmalloc_class_size(class);
+        void *ptr;
+
+        bug_on_always(class >= BRMALLOC_NCLASSES);
+        bug_on_always(csize < size);
+        bug_on_always(class && brmalloc_class_size(class - 1) >= size);
+        ptr = br_malloc(size);
+        bug_on_always(!ptr || br_usable_size(ptr) != csize);
+        memset(ptr, 0xa5, size);
+        br_free(ptr);
+    }
+    for (size_t size = BRMALLOC_MAX_SIZE + 1; size < 1 << 20; size = size * 3 / 2) {
+        void *ptr = br_malloc(size);
+
+        bug_on_always(!ptr || (uintptr_t)ptr % 16 || br_usable_size(ptr) != size);
+        memset(ptr, 0xa5, size);
+        br_free(ptr);
+    }
+    /* user data must not be mistaken for a large object: fill objects
+     * tails with large headers as older versions looked for, that is
+     * ("br large" ^ address, size), for the next object.
+     */
+    for (size_t size = 16; size <= BRMALLOC_MAX_SIZE; size *= 2) {
+        void *objs[64];
+
+        for (uint i = 0; i < ARRAY_SIZE(objs); ++i) {
+            u64 *tail;
+
+            objs[i] = br_malloc(size);
+            bug_on_always(!objs[i]);
+            tail = (u64 *)((char *)objs[i] + size) - 2;
+            tail[0] = 0x6272206c61726765ULL ^ (uintptr_t)tail;
+            tail[1] = size * 2;
+        }
+        for (uint i = 0; i < ARRAY_SIZE(objs); ++i) {
+            bug_on_always(br_usable_size(objs[i]) != size);
+            br_free(objs[i]);
+        }
+    }
+    printf("classes: %u classes, %zu to %zu bytes: ok\n", BRMALLOC_NCLASSES,
+           brmalloc_class_size(0), brmalloc_class_size(BRMALLOC_NCLASSES - 1));
+}
+
+/* blocks: fill several blocks of some size classes. Run it with libraries
+ * compiled with and without POOL_HARDEN: hardened objects are larger, but
+ * blocks must keep their size.
+ */
+static void check_blocks(void)
+{
+    static const size_t sizes[] = { 8, 64, 1024, BRMALLOC_MAX_SIZE };
+
+    for (uint s = 0; s < ARRAY_SIZE(sizes); ++s) {
+        u32 n = 3 * BRMALLOC_BLOCK_SIZE / sizes[s];
+        void **objs = malloc(n * sizeof(*objs));
+
+        bug_on_always(!objs);
+        for (u32 i = 0; i < n; ++i) {
+            objs[i] = br_malloc(sizes[s]);
+            bug_on_always(!objs[i] || br_usable_size(objs[i]) != sizes[s]);
+            memset(objs[i], 0xa5, sizes[s]);
+        }
+        for (u32 i = 0; i < n; ++i)
+            br_free(objs[i]);
+        free(objs);
+    }
+    printf("blocks: %zu bytes blocks: ok\n", BRMALLOC_BLOCK_SIZE);
+}
+
+static void churn(const struct allocator *a, u32 ops, u32 window, u32 maxsize)
+{
+    void **slots = calloc(window, sizeof(*slots));
+    u64 rnd = 0x9E3779B97F4A7C15ULL;
+    s64 start, elapsed;
+
+    start = bench_ns();
+    for (u32 i = 0; i < ops; ++i) {
+        u64 r = bench_rand(&rnd);
+        u32 cur = r % window;
+
+        if (slots[cur]) {
+            a->free(slots[cur]);
+            slots[cur] = NULL;
+        } else {
+            size_t size = 8 + (r >> 32) % (maxsize - 7);
+            slots[cur] = a->alloc(size);
+            *(char *)slots[cur] = 1;
+        }
+    }
+    for (u32 i = 0; i < window; ++i)
+        a->free(slots[i]);
+    elapsed = bench_ns() - start;
+    printf("churn %-10s ops=%-9u window=%-7u time=%8.3fms  %8.2f Mops/s\n",
+           a->name, ops, window, elapsed / 1e6, bench_mops(ops, elapsed));
+    free(slots);
+}
+
+static void batch(const struct allocator *a, u32 ops, u32 window, u32 maxsize)
+{
+    void **slots = calloc(window, sizeof(*slots));
+    u64 rnd = 0x9E3779B97F4A7C15ULL;
+    s64 start, elapsed;
+
+    start = bench_ns();
+    for (u32 n = 0; n < ops; n += window) {
+        for (u32 i = 0; i < window; ++i) {
+            slots[i] = a->alloc(8 + bench_rand(&rnd) % (maxsize - 7));
+            *(char *)slots[i] = 1;
+        }
+        for (u32 i = 0; i < window; ++i)
+            a->free(slots[i]);
+    }
+    elapsed = bench_ns() - start;
+    printf("batch %-10s ops=%-9u window=%-7u time=%8.3fms  %8.2f Mops/s\n",
+           a->name, ops, window, elapsed / 1e6, bench_mops(ops, elapsed));
+    free(slots);
+}
+
+int main(int ac, char **av)
+{
+    u32 ops = 10000000, window = 4096, maxsize = 256;
+    int opt;
+
+    while ((opt = getopt(ac, av, "o:w:s:")) != -1) {
+        switch (opt) {
+            case 'o':
+                ops = atoi(optarg);
+                break;
+            case 'w':
+                window = atoi(optarg);
+                break;
+            case 's':
+                maxsize = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-o ops] [-w window] [-s maxsize]\n", *av);
+                exit(1);
+        }
+    }
+    if (maxsize < 8)
+        maxsize = 8;
+    check_classes();
+    check_blocks();
+    for (uint i = 0; i < ARRAY_SIZE(allocators); ++i)
+        churn(allocators + i, ops, window, maxsize);
+    for (uint i = 0; i < ARRAY_SIZE(allocators); ++i)
+        batch(allocators + i, ops, window, maxsize);
+    br_malloc_stats();
+    exit(0);
+}
@@ -0,0 +1,273 @@
+/* cuckoo-bench.c - cuckoo hashtables tail latency benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: cuckoo-bench [-n keys] [-a] [-d debuglevel]
+ *
+ * @keys u64 keys are inserted, then looked up in random order (half of them
+ * are misses), then deleted, from:
+ *   - htable: a resizable chained hashtable, indexed with hash_64().
+ *   - swiss:  a Swiss table.
+ *   - cuckoo: a cuckoo hashtable, without and with size hint ("cuckoo-h").
+ * Each operation is timed: latency percentiles are displayed (they include
+ * the clock overhead). Tables contents are checked.
+ * With -a, keys are chosen to collide in hash_64(), whatever the table size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "debug.h"
+#include "hash.h"
+#include "htable.h"
+#include "swiss.h"
+#include "cuckoo.h"
+#include "bench.h"
+
+struct node {
+    u64 key;
+    u64 val;
+    struct hlist_node hlist;
+};
+
+static s64 *lat;
+
+static int cmp_s64(const void *a, const void *b)
+{
+    s64 x = *(const s64 *)a, y = *(const s64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* sort latencies and display percentiles.
+ */
+static void result(char *table, char *op, u64 n)
+{
+    s64 total = 0;
+
+    for (u64 i = 0; i < n; ++i)
+        total += lat[i];
+    qsort(lat, n, sizeof(*lat), cmp_s64);
+    printf("%-8s %-7s ops=%-8llu mean=%8.1f p50=%6lld p99=%7lld p99.9=%8lld max=%9lld ns\n",
+           table, op, (ullong) n, (double) total / n, (llong) lat[n / 2],
+           (llong) lat[n * 99 / 100], (llong) lat[n * 999 / 1000],
+           (llong) lat[n - 1]);
+}
+
+static u64 node_key(const struct hlist_node *hlist)
+{
+    return container_of(hlist, struct node, hlist)->key;
+}
+
+static struct node *htable_find(htable_t *ht, u64 key)
+{
+    struct node *node;
+
+    htable_for_each_possible(ht, node, hlist, key)
+        if (node->key == key)
+            break;
+    return node;
+}
+
+static void bench_htable(u64 *keys, u64 *lookups, u64 n)
+{
+    struct node *nodes = malloc(n * sizeof(*nodes));
+    htable_t ht;
+    u64 found = 0;
+
+    bug_on_always(!nodes || htable_init(&ht, HTABLE_MIN_BITS, node_key));
+    for (u64 i = 0; i < n; ++i) {
+        s64 start = bench_ns();
+
+        nodes[i].key = keys[i];
+        nodes[i].val = ~keys[i];
+        htable_add(&ht, &nodes[i].hlist, keys[i]);
+        lat[i] = bench_ns() - start;
+    }
+    result("htable", "insert", n);
+    for (u64 i = 0; i < n; ++i) {
+        s64 start = bench_ns();
+        struct node *node = htable_find(&ht, lookups[i]);
+
+        lat[i] = bench_ns() - start;
+        if (node) {
+            bug_on_always(node->val != ~lookups[i]);
+            found++;
+        }
+    }
+    result("htable", "lookup", n);
+    bug_on_always(found != n / 2);
+    for (u64 i = 0; i < n; ++i) {
+        s64 start = bench_ns();
+
+        htable_del(&ht, &nodes[i].hlist);
+        lat[i] = bench_ns() - start;
+    }
+    result("htable", "delete", n);
+    bug_on_always(htable_count(&ht));
+    htable_free(&ht);
+    free(nodes);
+}
+
+static void bench_swiss(u64 *keys, u64 *lookups, u64 n)
+{
+    swiss_t *table = swiss_create(sizeof(u64), sizeof(u64), 0, NULL, NULL);
+    u64 found = 0;
+
+    bug_on_always(!table);
+    for (u64 i = 0; i < n; ++i) {
+        s64 start = bench_ns();
+        u64 val = ~keys[i];
+
+        bug_on_always(!swiss_put(table, keys + i, &val));
+        lat[i] = bench_ns() - start;
+    }
+    result("swiss", "insert", n);
+    for (u64 i = 0; i < n; ++i) {
+        s64 start = bench_ns();
+        u64 *val = swiss_get(table, lookups + i);
+
+        lat[i] = bench_ns() - start;
+        if (val) {
+            bug_on_always(*val != ~lookups[i]);
+            found++;
+        }
+    }
+    result("swiss", "lookup", n);
+    bug_on_always(found != n / 2);
+    for (u64 i = 0; i < n; ++i) {
+        s64 start = bench_ns();
+
+        bug_on_always(!swiss_del(table, keys + i));
+        lat[i] = bench_ns() - start;
+    }
+    result("swiss", "delete", n);
+    bug_on_always(swiss_count(table));
+    swiss_destroy(table);
+}
+
+static void bench_cuckoo(char *name, u64 *keys, u64 *lookups, u64 n, u64 hint)
+{
+    cuckoo_t *table = cuckoo_create(hint);
+    u64 found = 0, pos = 0, key, *val;
+
+    bug_on_always(!table);
+    for (u64 i = 0; i < n; ++i) {
+        s64 start = bench_ns();
+
+        bug_on_always(cuckoo_put(table, keys[i], ~keys[i]));
+        lat[i] = bench_ns() - start;
+    }
+    result(name, "insert", n);
+    bug_on_always(cuckoo_count(table) != n);
+    cuckoo_stats(table);
+    printf("         buckets=%llu load=%.1f%% kicks=%llu maxkicks=%llu "
+           "grows=%llu reseeds=%llu\n", 1ULL << table->bits,
+           cuckoo_count(table) * 100.0 / cuckoo_capacity(table),
+           (ullong) table->kicks, (ullong) table->maxkicks,
+           (ullong) table->grows, (ullong) table->reseeds);
+    while ((val = cuckoo_next(table, &pos, &key))) {
+        bug_on_always(*val != ~key);
+        found++;
+    }
+    bug_on_always(found != n);
+
+    found = 0;
+    for (u64 i = 0; i < n; ++i) {
+        s64 start = bench_ns();
+
+        val = cuckoo_get(table, lookups[i]);
+        lat[i] = bench_ns() - start;
+        if (val) {
+            bug_on_always(*val != ~lookups[i]);
+            found++;
+        }
+    }
+    result(name, "lookup", n);
+    bug_on_always(found != n / 2);
+    for (u64 i = 0; i < n; ++i) {
+        s64 start = bench_ns();
+
+        bug_on_always(!cuckoo_del(table, keys[i]));
+        lat[i] = bench_ns() - start;
+    }
+    result(name, "delete", n);
+    bug_on_always(cuckoo_count(table));
+    cuckoo_destroy(table);
+}
+
+int main(int ac, char **av)
+{
+    u64 n = 0, rand = 1, inv = GOLDEN_RATIO_64;
+    u64 *keys, *lookups;
+    bool adversarial = false;
+    int opt, level = 0;
+
+    while ((opt = getopt(ac, av, "n:ad:")) != -1) {
+        switch (opt) {
+            case 'n':
+                n = atoll(optarg);
+                break;
+            case 'a':
+                adversarial = true;
+                break;
+            case 'd':
+                level = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n keys] [-a] [-d debuglevel]\n", *av);
+                exit(1);
+        }
+    }
+    if (!n)                                       /* htable is O(n^2) with -a */
+        n = adversarial? 20000: 1000000;
+    debug_init(level, stderr, true);
+    keys = malloc(2 * n * sizeof(*keys));
+    lookups = malloc(n * sizeof(*lookups));
+    lat = malloc(n * sizeof(*lat));
+    if (!keys || !lookups || !lat) {
+        perror("malloc");
+        exit(1);
+    }
+
+    /* inverse of GOLDEN_RATIO_64 (mod 2^64), by Newton iterations: keys
+     * i * inv give i when multiplied by GOLDEN_RATIO_64, that is the same
+     * hash_64() high bits (0) for all i < 2^(64 - bits).
+     */
+    for (int i = 0; i < 5; ++i)
+        inv *= 2 - GOLDEN_RATIO_64 * inv;
+    bug_on_always(inv * GOLDEN_RATIO_64 != 1);
+
+    /* keys[0..n-1] are inserted, keys[n..2n-1] are misses */
+    for (u64 i = 0; i < 2 * n; ++i)
+        keys[i] = adversarial? (i + 1) * inv: bench_rand(&rand);
+    for (u64 i = 0; i < n; ++i)
+        lookups[i] = i & 1? keys[n + bench_rand(&rand) % n]:
+            keys[bench_rand(&rand) % n];
+    for (u64 i = n - 1; i > 0; --i) {
+        u64 j = bench_rand(&rand) % (i + 1);
+
+        swap(lookups[i], lookups[j]);
+    }
+
+    printf("keys=%llu %s\n", (ullong) n, adversarial? "adversarial": "random");
+    bench_htable(keys, lookups, n);
+    bench_swiss(keys, lookups, n);
+    bench_cuckoo("cuckoo", keys, lookups, n, 0);
+    bench_cuckoo("cuckoo-h", keys, lookups, n, n);
+
+    free(keys);
+    free(lookups);
+    free(lat);
+    return 0;
+}
@@ -0,0 +1,148 @@
+/* hashstats-bench.c - hashtables chain-length diagnostics benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: hashstats-bench [-n entries] [-d debuglevel]
+ *
+ * Fills a DEFINE_HASHTABLE table with @entries keys from different
+ * distributions (sequential, random, page-strided addresses, malloc(3)
+ * addresses, high bits only), using different bucket functions, and reports
+ * hash_stats() results and walk time. Statistics are checked against a
+ * direct count of the table entries.
+ * With -d, hash_stats_log() output is displayed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "debug.h"
+#include "hashtable.h"
+#include "hashstats.h"
+#include "bench.h"
+
+#define HT_BITS 16
+
+struct obj {
+    u64 key;
+    struct hlist_node hlist;
+};
+
+static DEFINE_HASHTABLE(ht, HT_BITS);
+
+enum dist { SEQ, RAND, PAGE, MALLOC, HIGH, NDIST };
+static char *dists[] = { "sequential", "random", "page", "malloc", "high" };
+
+enum hfn { HASH_MIN, HASH_32, MASK, NHFN };
+static char *hfns[] = { "hash_min", "hash_32", "mask" };
+
+static u64 key_gen(enum dist dist, u64 i, u64 *rand)
+{
+    switch (dist) {
+        case SEQ:
+            return i;
+        case RAND:
+            return bench_rand(rand);
+        case PAGE:
+            return 0x7f0000000000ULL + (i << 12);
+        case MALLOC:
+            return (uintptr_t) malloc(48);
+        case HIGH:
+        default:
+            return i << 40;
+    }
+}
+
+static u32 bucket(enum hfn hfn, u64 key)
+{
+    switch (hfn) {
+        case HASH_MIN:
+            return hash_min(key, HT_BITS);
+        case HASH_32:
+            return hash_32((u32) key, HT_BITS);
+        case MASK:
+        default:
+            return key & ((1 << HT_BITS) - 1);
+    }
+}
+
+static void run(struct obj *objs, u64 n, enum dist dist, enum hfn hfn)
+{
+    hash_stats_t stats;
+    u64 entries = 0;
+    s64 ns;
+    char name[32];
+    uint bkt;
+    struct obj *obj;
+
+    hash_init(ht);
+    for (u64 i = 0; i < n; ++i)
+        hlist_add_head(&objs[i].hlist, &ht[bucket(hfn, objs[i].key)]);
+
+    hash_stats_init(&stats);
+    ns = bench_ns();
+    hash_stats(ht, &stats);
+    ns = bench_ns() - ns;
+
+    hash_for_each(ht, bkt, obj, hlist)
+        entries++;
+    bug_on_always(stats.entries != entries || entries != n);
+    bug_on_always(stats.buckets != HASH_SIZE(ht));
+
+    printf("%-10s %-8s empty=%5.1f%% mean=%6.2f max=%-6llu hit=%8.3f "
+           "ideal=%.3f ratio=%7.2f walk=%8.3fms (%.2f ns/bucket)\n",
+           dists[dist], hfns[hfn], hash_stats_empty(&stats) * 100.0,
+           hash_stats_mean(&stats), (ullong) stats.maxchain,
+           hash_stats_hit_cost(&stats), hash_stats_ideal_cost(&stats),
+           hash_stats_hit_cost(&stats) / hash_stats_ideal_cost(&stats),
+           ns / 1e6, (double) ns / stats.buckets);
+    snprintf(name, sizeof(name), "%s/%s", dists[dist], hfns[hfn]);
+    hash_stats_log(name, &stats);
+}
+
+int main(int ac, char **av)
+{
+    u64 n = 1 << HT_BITS, rand = 1;
+    int opt, level = 0;
+    struct obj *objs;
+
+    while ((opt = getopt(ac, av, "n:d:")) != -1) {
+        switch (opt) {
+            case 'n':
+                n = atoll(optarg);
+                break;
+            case 'd':
+                level = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n entries] [-d debuglevel]\n", *av);
+                exit(1);
+        }
+    }
+    debug_init(level, stderr, true);
+    if (!(objs = malloc(n * sizeof(*objs)))) {
+        perror("malloc");
+        exit(1);
+    }
+    printf("%llu entries, %u buckets\n", (ullong) n, 1U << HT_BITS);
+    for (enum dist dist = 0; dist < NDIST; ++dist) {
+        for (u64 i = 0; i < n; ++i)
+            objs[i].key = key_gen(dist, i, &rand);
+        for (enum hfn hfn = 0; hfn < NHFN; ++hfn)
+            run(objs, n, dist, hfn);
+        if (dist == MALLOC)
+            for (u64 i = 0; i < n; ++i)
+                free((void *)(uintptr_t) objs[i].key);
+    }
+    free(objs);
+    return 0;
+}
@@ -0,0 +1,173 @@
+/* hashtable-batch-bench.c - hashtable batched lookups benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: hashtable-batch-bench [-n entries] [-l lookups] [-m miss%] [batch...]
+ *
+ * Fills a (1 << HT_BITS) buckets hashtable with @entries objects, allocated in
+ * random order, then looks up @lookups random keys (@miss% of them absent),
+ * with:
+ *   - serial: a loop of hash_for_each_possible() lookups, where each key
+ *             depends on the previous result: this gives the memory latency.
+ *   - single: a loop of hash_for_each_possible() lookups.
+ *   - batch:  hash_lookup_batch() calls on @batch keys (default: 16 and 1024).
+ * Results of both are compared.
+ * The default table size (about 700Mb) is meant to exceed the last level
+ * cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "hashtable.h"
+#include "bench.h"
+
+#define HT_BITS 24
+
+struct obj {
+    u64 key;
+    u64 val;
+    struct hlist_node hlist;
+};
+
+static DEFINE_HASHTABLE(ht, HT_BITS);
+
+static struct obj *lookup(u64 key)
+{
+    struct obj *obj;
+
+    hash_for_each_possible(ht, obj, hlist, key)
+        if (obj->key == key)
+            return obj;
+    return NULL;
+}
+
+int main(int ac, char **av)
+{
+    u64 n = 1 << HT_BITS, nlookups = 1 << 22, miss = 10, rand = 1;
+    u64 *keys, sum = 0, found = 0;
+    struct obj **objs, **res, **ref;
+    s64 ns;
+    int opt;
+
+    while ((opt = getopt(ac, av, "n:l:m:")) != -1) {
+        switch (opt) {
+            case 'n':
+                n = atoll(optarg);
+                break;
+            case 'l':
+                nlookups = atoll(optarg);
+                break;
+            case 'm':
+                miss = atoll(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n entries] [-l lookups] [-m miss%%] [batch...]\n", *av);
+                exit(1);
+        }
+    }
+    objs = malloc(n * sizeof(*objs));
+    keys = malloc(nlookups * sizeof(*keys));
+    res = malloc(nlookups * sizeof(*res));
+    ref = malloc(nlookups * sizeof(*ref));
+    if (!objs || !keys || !res || !ref) {
+        perror("malloc");
+        exit(1);
+    }
+
+    /* keys are 0, 2, 4... so that odd keys are absent. Objects are
+     * allocated, then shuffled, so that buckets order and memory order differ.
+     */
+    for (u64 i = 0; i < n; ++i)
+        bug_on_always(!(objs[i] = malloc(sizeof(struct obj))));
+    for (u64 i = n - 1; i > 0; --i) {
+        u64 j = bench_rand(&rand) % (i + 1);
+
+        swap(objs[i], objs[j]);
+    }
+    for (u64 i = 0; i < n; ++i) {
+        objs[i]->key = i * 2;
+        objs[i]->val = ~objs[i]->key;
+        hash_add(ht, &objs[i]->hlist, objs[i]->key);
+    }
+    for (u64 i = 0; i < nlookups; ++i) {
+        keys[i] = (bench_rand(&rand) % n) * 2 + (bench_rand(&rand) % 100 < miss);
+        res[i] = NULL;                            /* fault pages in */
+    }
+
+    printf("entries=%llu buckets=%u lookups=%llu miss=%llu%%\n", (ullong) n,
+           1U << HT_BITS, (ullong) nlookups, (ullong) miss);
+
+    /* vals are ~key, with keys below 2^63: dep is always 0, but the compiler
+     * does not know.
+     */
+    ns = bench_ns();
+    for (u64 i = 0, dep = 0; i < nlookups; ++i) {
+        struct obj *obj = lookup(keys[i] + dep);
+
+        dep = obj? ~obj->val >> 63: 0;
+    }
+    ns = bench_ns() - ns;
+    printf("serial      time=%10.3fms %7.2f Mops/s %6.1f ns/lookup\n",
+           ns / 1e6, bench_mops(nlookups, ns), (double) ns / nlookups);
+
+    ns = bench_ns();
+    for (u64 i = 0; i < nlookups; ++i) {
+        ref[i] = lookup(keys[i]);
+        if (ref[i])
+            sum += ref[i]->val;
+    }
+    ns = bench_ns() - ns;
+    for (u64 i = 0; i < nlookups; ++i)
+        found += !!ref[i];
+    printf("single      time=%10.3fms %7.2f Mops/s %6.1f ns/lookup found=%llu\n",
+           ns / 1e6, bench_mops(nlookups, ns), (double) ns / nlookups,
+           (ullong) found);
+
+    if (optind == ac) {                           /* default batches */
+        static char *defaults[] = { "16", "1024" };
+        av = defaults;
+        optind = 0;
+        ac = ARRAY_SIZE(defaults);
+    }
+    for (; optind < ac; ++optind) {
+        u64 batch = atoll(av[optind]), bsum = 0;
+
+        if (!batch)
+            continue;
+        ns = bench_ns();
+        for (u64 i = 0; i < nlookups; i += batch) {
+            u64 cnt = min(batch, nlookups - i);
+
+            hash_lookup_batch(ht, keys + i, cnt, res + i, hlist, key);
+            for (u64 j = i; j < i + cnt; ++j)
+                if (res[j])
+                    bsum += res[j]->val;
+        }
+        ns = bench_ns() - ns;
+        for (u64 i = 0; i < nlookups; ++i)
+            bug_on_always(res[i] != ref[i]);
+        bug_on_always(bsum != sum);
+        printf("batch %-5llu time=%10.3fms %7.2f Mops/s %6.1f ns/lookup\n",
+               (ullong) batch, ns / 1e6, bench_mops(nlookups, ns),
+               (double) ns / nlookups);
+    }
+
+    for (u64 i = 0; i < n; ++i)
+        free(objs[i]);
+    free(objs);
+    free(keys);
+    free(res);
+    free(ref);
+    return 0;
+}
@@ -0,0 +1,314 @@
+/* hashtable-bl-bench.c - bit-locked hashtable multi-threaded benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: hashtable-bl-bench [-o ops] [-k keys] [-r read%] [nthreads...]
+ *
+ * hash_for_each_bl() is first checked, with and without break.
+ * Each thread owns @keys keys (half of them inserted first), and runs @ops
+ * random operations on them: @read% lookups, the rest being evenly split
+ * between inserts and deletes. As keys are private, lookups results are
+ * checked. This is done with:
+ *   - global: a DEFINE_HASHTABLE hashtable, protected by a global mutex.
+ *   - bl:     a DEFINE_HASHTABLE_BL hashtable, buckets are locked for all
+ *             operations.
+ *   - bl-rcu: a DEFINE_HASHTABLE_BL hashtable, buckets are locked for inserts
+ *             and deletes only, lookups use RCU, deleted objects are freed
+ *             with call_rcu().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "hashtable_bl.h"
+#include "rcu.h"
+#include "bench.h"
+
+#define HT_BITS 16
+#define POISON  0xdeadbeefdeadbeefULL
+
+struct obj {
+    u64 key;
+    u64 val;                                      /* ~key, or POISON */
+    union {
+        struct hlist_node hlist;
+        struct hlist_bl_node hlist_bl;
+    };
+    struct rcu_head rcu;
+};
+
+enum mode { GLOBAL, BL, BL_RCU };
+static char *modes[] = { "global", "bl", "bl-rcu" };
+
+static DEFINE_HASHTABLE(ht, HT_BITS);
+static DEFINE_HASHTABLE_BL(ht_bl, HT_BITS);
+static pthread_mutex_t ht_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct thread_arg {
+    pthread_t thread;
+    enum mode mode;
+    u32 id;
+    u32 ops;
+    u32 keys;
+    u32 read;
+    bool *present;
+    u64 errors;
+};
+
+static void obj_free(struct obj *obj)
+{
+    WRITE_ONCE(obj->val, POISON);
+    free(obj);
+}
+
+static void obj_free_rcu(struct rcu_head *head)
+{
+    obj_free(container_of(head, struct obj, rcu));
+}
+
+static struct obj *lookup(enum mode mode, u64 key)
+{
+    struct hlist_bl_node *pos;
+    struct obj *obj;
+
+    switch (mode) {
+        case GLOBAL:
+            hash_for_each_possible(ht, obj, hlist, key)
+                if (obj->key == key)
+                    return obj;
+            break;
+        case BL:
+            hash_for_each_possible_bl(ht_bl, obj, pos, hlist_bl, key)
+                if (obj->key == key)
+                    return obj;
+            break;
+        case BL_RCU:
+            hash_for_each_possible_bl_rcu(ht_bl, obj, pos, hlist_bl, key)
+                if (obj->key == key)
+                    return obj;
+            break;
+    }
+    return NULL;
+}
+
+static void insert(enum mode mode, u64 key)
+{
+    struct obj *obj = malloc(sizeof(*obj));
+
+    obj->key = key;
+    obj->val = ~key;
+    if (mode == GLOBAL) {
+        pthread_mutex_lock(&ht_lock);
+        hash_add(ht, &obj->hlist, key);
+        pthread_mutex_unlock(&ht_lock);
+    } else {
+        hash_add_bl(ht_bl, &obj->hlist_bl, key);
+    }
+}
+
+static void delete(enum mode mode, u64 key)
+{
+    struct hlist_bl_head *b;
+    struct obj *obj;
+
+    switch (mode) {
+        case GLOBAL:
+            pthread_mutex_lock(&ht_lock);
+            obj = lookup(mode, key);
+            hash_del(&obj->hlist);
+            pthread_mutex_unlock(&ht_lock);
+            obj_free(obj);
+            break;
+        case BL:
+        case BL_RCU:
+            b = hash_bl_head(ht_bl, key);
+            hlist_bl_lock(b);
+            obj = lookup(BL, key);
+            hlist_bl_del_rcu(&obj->hlist_bl);
+            hlist_bl_unlock(b);
+            if (mode == BL)
+                obj_free(obj);
+            else
+                call_rcu(&obj->rcu, obj_free_rcu);
+            break;
+    }
+}
+
+static bool check(enum mode mode, u64 key)
+{
+    struct hlist_bl_head *b = NULL;
+    struct obj *obj;
+    bool found;
+
+    switch (mode) {
+        case GLOBAL:
+            pthread_mutex_lock(&ht_lock);
+            break;
+        case BL:
+            b = hash_bl_head(ht_bl, key);
+            hlist_bl_lock(b);
+            break;
+        case BL_RCU:
+            rcu_read_lock();
+            break;
+    }
+    obj = lookup(mode, key);
+    found = obj && READ_ONCE(obj->val) == ~key;
+    switch (mode) {
+        case GLOBAL:
+            pthread_mutex_unlock(&ht_lock);
+            break;
+        case BL:
+            hlist_bl_unlock(b);
+            break;
+        case BL_RCU:
+            rcu_read_unlock();
+            break;
+    }
+    return found;
+}
+
+/* hash_for_each_bl() visits all objects, and a break leaves the cursor on
+ * the current object, like hash_for_each().
+ */
+static void check_walk(void)
+{
+    struct hlist_bl_node *pos;
+    struct obj *obj;
+    u32 count = 0;
+    uint bkt;
+
+    for (u64 k = 0; k < 1000; ++k)
+        insert(BL, k);
+    hash_for_each_bl(ht_bl, bkt, obj, pos, hlist_bl)
+        count++;
+    bug_on_always(count != 1000 || obj);
+    hash_for_each_bl(ht_bl, bkt, obj, pos, hlist_bl)
+        if (obj->key == 500)
+            break;
+    bug_on_always(!obj || obj->key != 500);
+    for (u64 k = 0; k < 1000; ++k)
+        delete(BL, k);
+    printf("walk: ok\n");
+}
+
+static void *worker(void *p)
+{
+    struct thread_arg *arg = p;
+    u64 rnd = arg->id + 1, base = (u64) arg->id * arg->keys;
+
+    for (u32 i = 0; i < arg->ops; ++i) {
+        u64 r = bench_rand(&rnd);
+        u32 k = (r >> 32) % arg->keys;
+        u32 op = r % 100;
+
+        if (op < arg->read) {
+            if (check(arg->mode, base + k) != arg->present[k])
+                arg->errors++;
+        } else if (op & 1) {
+            if (!arg->present[k]) {
+                insert(arg->mode, base + k);
+                arg->present[k] = true;
+            }
+        } else if (arg->present[k]) {
+            delete(arg->mode, base + k);
+            arg->present[k] = false;
+        }
+    }
+    return NULL;
+}
+
+static void bench(enum mode mode, u32 nthreads, u32 ops, u32 keys, u32 read)
+{
+    struct thread_arg *args = calloc(nthreads, sizeof(*args));
+    struct hlist_bl_node *pos, *n;
+    struct hlist_node *tmp;
+    struct obj *obj;
+    u64 errors = 0;
+    s64 start, elapsed;
+    uint bkt;
+
+    for (u32 t = 0; t < nthreads; ++t) {
+        args[t] = (struct thread_arg) {
+            .mode = mode, .id = t, .ops = ops, .keys = keys, .read = read,
+            .present = calloc(keys, sizeof(bool))
+        };
+        for (u32 k = 0; k < keys; k += 2) {
+            insert(mode, (u64) t * keys + k);
+            args[t].present[k] = true;
+        }
+    }
+    start = bench_ns();
+    for (u32 t = 0; t < nthreads; ++t)
+        pthread_create(&args[t].thread, NULL, worker, args + t);
+    for (u32 t = 0; t < nthreads; ++t) {
+        pthread_join(args[t].thread, NULL);
+        errors += args[t].errors;
+        free(args[t].present);
+    }
+    elapsed = bench_ns() - start;
+    rcu_barrier();
+
+    printf("%-6s threads=%-3u ops=%-9lu read=%u%%  time=%8.3fms  %8.2f Mops/s  errors=%lu\n",
+           modes[mode], nthreads, (u64) ops * nthreads, read, elapsed / 1e6,
+           bench_mops((u64) ops * nthreads, elapsed), errors);
+    bug_on_always(errors);
+
+    hash_for_each_safe(ht, bkt, tmp, obj, hlist) {
+        hash_del(&obj->hlist);
+        free(obj);
+    }
+    for (bkt = 0; bkt < HASH_SIZE(ht_bl); ++bkt) {
+        hlist_bl_for_each_entry_safe(obj, pos, n, &ht_bl[bkt], hlist_bl)
+            free(obj);
+        INIT_HLIST_BL_HEAD(&ht_bl[bkt]);
+    }
+    free(args);
+}
+
+int main(int ac, char **av)
+{
+    static const u32 deflt[] = { 1, 2, 4, 8 };
+    u32 ops = 2000000, keys = 1 << 15, read = 80;
+    int opt;
+
+    while ((opt = getopt(ac, av, "o:k:r:")) != -1) {
+        switch (opt) {
+            case 'o':
+                ops = atoi(optarg);
+                break;
+            case 'k':
+                keys = atoi(optarg);
+                break;
+            case 'r':
+                read = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-o ops] [-k keys] [-r read%%] [nthreads...]\n",
+                        *av);
+                exit(1);
+        }
+    }
+    check_walk();
+    for (uint m = 0; m < ARRAY_SIZE(modes); ++m) {
+        if (optind == ac) {
+            for (uint i = 0; i < ARRAY_SIZE(deflt); ++i)
+                bench(m, deflt[i], ops, keys, read);
+        } else {
+            for (int i = optind; i < ac; ++i)
+                bench(m, atoi(av[i]), ops, keys, read);
+        }
+    }
+    exit(0);
+}
@@ -0,0 +1,252 @@
+/* hashtable-tag-bench.c - tagged hashtables memory and speed benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: hashtable-tag-bench [-n entries] [-l lookups]
+ *
+ * @entries random u64 keys (with a u64 value) are inserted in a (1 << HT_BITS)
+ * buckets hashtable, then @lookups random keys are looked up (hits, then
+ * misses), then half of the entries are deleted, and the other half is
+ * checked. Tables are:
+ *   - hlist: DEFINE_HASHTABLE, hlist_node.
+ *   - tag:   DEFINE_HASHTABLE_TAG, hlist_tag_node (tagged, doubly linked).
+ *   - stag:  DEFINE_HASHTABLE_STAG, slist_tag_node (tagged, singly linked).
+ * Memory per entry includes buckets. Tables contents are checked, as well as
+ * walks stopped with break.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "hashtable_tag.h"
+#include "bench.h"
+
+#define HT_BITS 22
+
+struct obj_hlist {
+    u64 key;
+    u64 val;
+    struct hlist_node node;
+};
+
+struct obj_tag {
+    u64 key;
+    u64 val;
+    struct hlist_tag_node node;
+};
+
+struct obj_stag {
+    u64 key;
+    u64 val;
+    struct slist_tag_node node;
+};
+
+static DEFINE_HASHTABLE(ht_hlist, HT_BITS);
+static DEFINE_HASHTABLE_TAG(ht_tag, HT_BITS);
+static DEFINE_HASHTABLE_STAG(ht_stag, HT_BITS);
+
+/* lookup @k in @name table, with @obj cursor and @iter lookup macro. Result
+ * is in @obj.
+ */
+#define LOOKUP(name, obj, iter, k) do {                               \
+        iter(name, obj, node, k)                                    \
+            if (obj->key == k)                                      \
+                break;                                              \
+    } while (0)
+
+static void result(char *table, char *op, u64 n, s64 ns)
+{
+    printf("%-6s %-7s ops=%-9llu time=%9.3fms %7.1f ns/op\n", table, op,
+           (ullong) n, ns / 1e6, (double) ns / n);
+}
+
+static void memory(char *table, size_t buckets, size_t node, size_t obj, u64 n)
+{
+    printf("%-6s memory: bucket=%zu node=%zu entry=%zu bytes, per entry: "
+           "overhead=%.1f total=%.1f bytes\n", table, buckets / HASH_SIZE(ht_hlist),
+           node, obj, (double) (buckets + n * node) / n,
+           (double) (buckets + n * obj) / n);
+}
+
+int main(int ac, char **av)
+{
+    u64 n = 1 << HT_BITS, nlookups = 1 << 22, rand = 1;
+    u64 *keys, *hits, *misses, found;
+    struct obj_hlist *hlist, *oh;
+    struct obj_tag *tag, *ot;
+    struct obj_stag *stag, *os;
+    uint bkt;
+    s64 ns;
+    int opt;
+
+    while ((opt = getopt(ac, av, "n:l:")) != -1) {
+        switch (opt) {
+            case 'n':
+                n = atoll(optarg);
+                break;
+            case 'l':
+                nlookups = atoll(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n entries] [-l lookups]\n", *av);
+                exit(1);
+        }
+    }
+    keys = malloc(n * sizeof(*keys));
+    hits = malloc(nlookups * sizeof(*hits));
+    misses = malloc(nlookups * sizeof(*misses));
+    hlist = malloc(n * sizeof(*hlist));
+    tag = malloc(n * sizeof(*tag));
+    stag = malloc(n * sizeof(*stag));
+    if (!keys || !hits || !misses || !hlist || !tag || !stag) {
+        perror("malloc");
+        exit(1);
+    }
+    for (u64 i = 0; i < n; ++i)
+        keys[i] = bench_rand(&rand);
+    for (u64 i = 0; i < nlookups; ++i) {
+        hits[i] = keys[bench_rand(&rand) % n];
+        misses[i] = bench_rand(&rand);            /* collisions are unlikely */
+    }
+    printf("entries=%llu buckets=%u lookups=%llu\n", (ullong) n, 1U << HT_BITS,
+           (ullong) nlookups);
+    memory("hlist", sizeof(ht_hlist), sizeof(struct hlist_node), sizeof(*hlist), n);
+    memory("tag", sizeof(ht_tag), sizeof(struct hlist_tag_node), sizeof(*tag), n);
+    memory("stag", sizeof(ht_stag), sizeof(struct slist_tag_node), sizeof(*stag), n);
+
+    /* inserts */
+    ns = bench_ns();
+    for (u64 i = 0; i < n; ++i) {
+        hlist[i].key = keys[i];
+        hlist[i].val = ~keys[i];
+        hash_add(ht_hlist, &hlist[i].node, keys[i]);
+    }
+    result("hlist", "insert", n, bench_ns() - ns);
+    ns = bench_ns();
+    for (u64 i = 0; i < n; ++i) {
+        tag[i].key = keys[i];
+        tag[i].val = ~keys[i];
+        hash_add_tag(ht_tag, &tag[i].node, keys[i]);
+    }
+    result("tag", "insert", n, bench_ns() - ns);
+    ns = bench_ns();
+    for (u64 i = 0; i < n; ++i) {
+        stag[i].key = keys[i];
+        stag[i].val = ~keys[i];
+        hash_add_stag(ht_stag, &stag[i].node, keys[i]);
+    }
+    result("stag", "insert", n, bench_ns() - ns);
+
+    found = 0;
+    hash_for_each(ht_hlist, bkt, oh, node)
+        found++;
+    bug_on_always(found != n);
+    found = 0;
+    hash_for_each_tag(ht_tag, bkt, ot, node)
+        found++;
+    bug_on_always(found != n || ot);
+    found = 0;
+    hash_for_each_stag(ht_stag, bkt, os, node)
+        found++;
+    bug_on_always(found != n || os);
+
+    /* a break leaves the cursor on the current object */
+    hash_for_each_tag(ht_tag, bkt, ot, node)
+        if (ot->key == keys[n / 2])
+            break;
+    bug_on_always(!ot || ot->key != keys[n / 2]);
+    hash_for_each_stag(ht_stag, bkt, os, node)
+        if (os->key == keys[n / 2])
+            break;
+    bug_on_always(!os || os->key != keys[n / 2]);
+
+    /* hits */
+    ns = bench_ns();
+    for (u64 i = 0; i < nlookups; ++i) {
+        LOOKUP(ht_hlist, oh, hash_for_each_possible, hits[i]);
+        bug_on_always(!oh || oh->val != ~hits[i]);
+    }
+    result("hlist", "hit", nlookups, bench_ns() - ns);
+    ns = bench_ns();
+    for (u64 i = 0; i < nlookups; ++i) {
+        LOOKUP(ht_tag, ot, hash_for_each_possible_tag, hits[i]);
+        bug_on_always(!ot || ot->val != ~hits[i]);
+    }
+    result("tag", "hit", nlookups, bench_ns() - ns);
+    ns = bench_ns();
+    for (u64 i = 0; i < nlookups; ++i) {
+        LOOKUP(ht_stag, os, hash_for_each_possible_stag, hits[i]);
+        bug_on_always(!os || os->val != ~hits[i]);
+    }
+    result("stag", "hit", nlookups, bench_ns() - ns);
+
+    /* misses */
+    ns = bench_ns();
+    for (u64 i = 0; i < nlookups; ++i) {
+        LOOKUP(ht_hlist, oh, hash_for_each_possible, misses[i]);
+        bug_on_always(oh);
+    }
+    result("hlist", "miss", nlookups, bench_ns() - ns);
+    ns = bench_ns();
+    for (u64 i = 0; i < nlookups; ++i) {
+        LOOKUP(ht_tag, ot, hash_for_each_possible_tag, misses[i]);
+        bug_on_always(ot);
+    }
+    result("tag", "miss", nlookups, bench_ns() - ns);
+    ns = bench_ns();
+    for (u64 i = 0; i < nlookups; ++i) {
+        LOOKUP(ht_stag, os, hash_for_each_possible_stag, misses[i]);
+        bug_on_always(os);
+    }
+    result("stag", "miss", nlookups, bench_ns() - ns);
+
+    /* deletes: odd entries are deleted (timed), tables are checked, then
+     * even entries are deleted.
+     */
+    ns = bench_ns();
+    for (u64 i = 1; i < n; i += 2)
+        hash_del(&hlist[i].node);
+    result("hlist", "delete", n / 2, bench_ns() - ns);
+    ns = bench_ns();
+    for (u64 i = 1; i < n; i += 2)
+        hash_del_tag(&tag[i].node);
+    result("tag", "delete", n / 2, bench_ns() - ns);
+    ns = bench_ns();
+    for (u64 i = 1; i < n; i += 2)
+        bug_on_always(!hash_del_stag(ht_stag, &stag[i].node, keys[i]));
+    result("stag", "delete", n / 2, bench_ns() - ns);
+    for (u64 i = 0; i < n; ++i) {
+        LOOKUP(ht_hlist, oh, hash_for_each_possible, keys[i]);
+        LOOKUP(ht_tag, ot, hash_for_each_possible_tag, keys[i]);
+        LOOKUP(ht_stag, os, hash_for_each_possible_stag, keys[i]);
+        bug_on_always((oh == NULL) != (i & 1) || (ot == NULL) != (i & 1) ||
+                      (os == NULL) != (i & 1));
+    }
+    for (u64 i = 0; i < n; i += 2) {
+        hash_del(&hlist[i].node);
+        hash_del_tag(&tag[i].node);
+        bug_on_always(!hash_del_stag(ht_stag, &stag[i].node, keys[i]));
+    }
+    bug_on_always(!hash_empty(ht_hlist));
+    for (bkt = 0; bkt < HASH_SIZE(ht_tag); ++bkt)
+        bug_on_always(!hlist_tag_empty(ht_tag + bkt) ||
+                      !slist_tag_empty(ht_stag + bkt));
+
+    free(keys);
+    free(hits);
+    free(misses);
+    free(hlist);
+    free(tag);
+    free(stag);
+    return 0;
+}
@@ -0,0 +1,158 @@
+/* htable-bench.c - resizable hashtable benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: htable-bench [-n objects]
+ *
+ * insert: insert @objects objects, starting from an empty (16 buckets) table,
+ *         and report each insert latency: average, max, and number of inserts
+ *         above 10us. This is done with:
+ *         - incremental: htable_add().
+ *         - full:        htable_add() then htable_rehash(), i.e. the whole
+ *                        table is rehashed when it grows.
+ * lookup: look up all objects in the htable, with a pending rehash (if any),
+ *         then after rehash is completed.
+ * delete: delete all objects, the table shrinks back to 16 buckets.
+ * lookup fixed: insert all objects in a DEFINE_HASHTABLE table of 65536
+ *         buckets, and look up (at most) 100000 of them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "hashtable.h"
+#include "htable.h"
+#include "bench.h"
+
+struct obj {
+    u64 key;
+    struct hlist_node hlist;
+};
+
+static DEFINE_HASHTABLE(fixed, 16);
+
+static u64 obj_key(const struct hlist_node *node)
+{
+    return hlist_entry(node, struct obj, hlist)->key;
+}
+
+static void insert(htable_t *ht, struct obj *objs, u32 n, bool full)
+{
+    s64 start, elapsed, max = 0, total = 0;
+    u32 slow = 0;
+
+    htable_init(ht, 0, obj_key);
+    for (u32 i = 0; i < n; ++i) {
+        start = bench_ns();
+        htable_add(ht, &objs[i].hlist, objs[i].key);
+        if (full)
+            htable_rehash(ht);
+        elapsed = bench_ns() - start;
+        total += elapsed;
+        if (elapsed > max)
+            max = elapsed;
+        if (elapsed > 10000)
+            slow++;
+    }
+    printf("insert %-11s objs=%-9u buckets=%-9lu time=%8.3fms  avg=%6.1fns  "
+           "max=%9.3fus  >10us=%u\n", full? "full": "incremental", n,
+           htable_size(ht), total / 1e6, (double) total / n, max / 1e3, slow);
+}
+
+static void lookup(htable_t *ht, struct obj *objs, u32 n)
+{
+    struct obj *obj;
+    s64 start;
+
+    start = bench_ns();
+    for (u32 i = 0; i < n; ++i) {
+        u64 key = objs[i].key;
+
+        htable_for_each_possible(ht, obj, hlist, key)
+            if (obj->key == key)
+                break;
+        bug_on_always(obj != objs + i);
+    }
+    printf("lookup %-11s objs=%-9u buckets=%-9lu time=%8.3fms  %6.1f ns/lookup\n",
+           ht->old? "htable(rh)": "htable", n, htable_size(ht),
+           (bench_ns() - start) / 1e6, (double) (bench_ns() - start) / n);
+}
+
+static void lookup_fixed(struct obj *objs, u32 n)
+{
+    u32 nlookups = min(n, 100000U);
+    struct obj *obj;
+    s64 start;
+
+    for (u32 i = 0; i < n; ++i)
+        hash_add(fixed, &objs[i].hlist, objs[i].key);
+    start = bench_ns();
+    for (u32 i = 0; i < nlookups; ++i) {
+        u64 key = objs[i].key;
+
+        hash_for_each_possible(fixed, obj, hlist, key)
+            if (obj->key == key)
+                break;
+        bug_on_always(obj != objs + i);
+    }
+    printf("lookup %-11s objs=%-9u buckets=%-9lu time=%8.3fms  %6.1f ns/lookup\n",
+           "fixed", n, HASH_SIZE(fixed), (bench_ns() - start) / 1e6,
+           (double) (bench_ns() - start) / nlookups);
+    hash_init(fixed);
+}
+
+static void delete(htable_t *ht, struct obj *objs, u32 n)
+{
+    s64 start = bench_ns();
+
+    for (u32 i = 0; i < n; ++i)
+        htable_del(ht, &objs[i].hlist);
+    printf("delete %-11s objs=%-9u buckets=%-9lu time=%8.3fms\n", "htable", n,
+           htable_size(ht), (bench_ns() - start) / 1e6);
+    bug_on_always(htable_count(ht) || ht->bits != HTABLE_MIN_BITS);
+}
+
+int main(int ac, char **av)
+{
+    u32 n = 4000000;
+    u64 rnd = 0x9E3779B97F4A7C15ULL;
+    struct obj *objs;
+    htable_t ht;
+    int opt;
+
+    while ((opt = getopt(ac, av, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                n = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n objects]\n", *av);
+                exit(1);
+        }
+    }
+    objs = malloc(n * sizeof(*objs));
+    for (u32 i = 0; i < n; ++i)
+        objs[i].key = bench_rand(&rnd);
+
+    insert(&ht, objs, n, true);
+    htable_free(&ht);
+    insert(&ht, objs, n, false);
+    lookup(&ht, objs, n);
+    htable_rehash(&ht);
+    lookup(&ht, objs, n);
+    delete(&ht, objs, n);
+    lookup_fixed(objs, n);
+    htable_free(&ht);
+    free(objs);
+    exit(0);
+}
@@ -0,0 +1,164 @@
+/* list-prefetch-bench.c - prefetching list iterators benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: list-prefetch-bench [-n nodes] [-w work] [-l loops]
+ *
+ * Nodes (one cache line each) are allocated from a pool, then linked in a
+ * list_head list and in a hlist:
+ * - pooled:    in allocation order: nodes are contiguous in memory.
+ * - scattered: in random order.
+ * Lists are walked @loops times with plain, prefetch and prefetch2 iterators,
+ * with no work, then @work dependent multiply/xor rounds per node.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "list.h"
+#include "pool.h"
+#include "bench.h"
+
+struct node {
+    struct list_head list;
+    struct hlist_node hlist;
+    u64 val;
+    char pad[64 - sizeof(struct list_head) - sizeof(struct hlist_node) - sizeof(u64)];
+};
+
+static __always_inline u64 work(u64 val, u32 rounds)
+{
+    for (u32 i = 0; i < rounds; ++i)
+        val = (val * 0x9E3779B97F4A7C15ULL) ^ (val >> 29);
+    return val;
+}
+
+enum iterator { PLAIN, PREFETCH, PREFETCH2 };
+static char *iterators[] = { "plain", "prefetch", "prefetch2" };
+
+static u64 walk_list(struct list_head *head, enum iterator it, u32 rounds)
+{
+    struct node *pos;
+    struct list_head *n;
+    u64 sum = 0;
+
+    switch (it) {
+        case PLAIN:
+            list_for_each_entry(pos, head, list)
+                sum += work(pos->val, rounds);
+            break;
+        case PREFETCH:
+            list_for_each_entry_prefetch(pos, head, list)
+                sum += work(pos->val, rounds);
+            break;
+        case PREFETCH2:
+            list_for_each_entry_prefetch2(pos, n, head, list)
+                sum += work(pos->val, rounds);
+            break;
+    }
+    return sum;
+}
+
+static u64 walk_hlist(struct hlist_head *head, enum iterator it, u32 rounds)
+{
+    struct node *pos;
+    struct hlist_node *n;
+    u64 sum = 0;
+
+    switch (it) {
+        case PLAIN:
+            hlist_for_each_entry(pos, head, hlist)
+                sum += work(pos->val, rounds);
+            break;
+        case PREFETCH:
+            hlist_for_each_entry_prefetch(pos, head, hlist)
+                sum += work(pos->val, rounds);
+            break;
+        case PREFETCH2:
+            hlist_for_each_entry_prefetch2(pos, n, head, hlist)
+                sum += work(pos->val, rounds);
+            break;
+    }
+    return sum;
+}
+
+static void bench(char *layout, struct node **nodes, u32 nnodes, u32 loops, u32 rounds)
+{
+    LIST_HEAD(head);
+    HLIST_HEAD(hhead);
+    u64 ref = 0;
+
+    for (u32 i = 0; i < nnodes; ++i) {
+        list_add_tail(&nodes[i]->list, &head);
+        hlist_add_head(&nodes[nnodes - 1 - i]->hlist, &hhead);
+    }
+    for (int type = 0; type < 2; ++type) {
+        for (uint it = 0; it < ARRAY_SIZE(iterators); ++it) {
+            u64 sum = 0;
+            s64 start = bench_ns(), elapsed;
+
+            for (u32 l = 0; l < loops; ++l)
+                sum += type? walk_hlist(&hhead, it, rounds): walk_list(&head, it, rounds);
+            elapsed = bench_ns() - start;
+            if (!ref)
+                ref = sum;
+            bug_on_always(sum != ref);
+            printf("%-9s %-5s %-9s work=%-3u %8.3fms  %6.2f ns/node\n", layout,
+                   type? "hlist": "list", iterators[it], rounds, elapsed / 1e6,
+                   (double) elapsed / ((u64) loops * nnodes));
+        }
+    }
+}
+
+int main(int ac, char **av)
+{
+    u32 nnodes = 1 << 20, rounds = 100, loops = 5;
+    u64 rnd = 0x9E3779B97F4A7C15ULL;
+    struct node **nodes;
+    pool_t *pool;
+    int opt;
+
+    while ((opt = getopt(ac, av, "n:w:l:")) != -1) {
+        switch (opt) {
+            case 'n':
+                nnodes = atoi(optarg);
+                break;
+            case 'w':
+                rounds = atoi(optarg);
+                break;
+            case 'l':
+                loops = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n nodes] [-w work] [-l loops]\n", *av);
+                exit(1);
+        }
+    }
+    pool = pool_create("nodes", 4096, sizeof(struct node));
+    nodes = malloc(nnodes * sizeof(*nodes));
+    for (u32 i = 0; i < nnodes; ++i) {
+        nodes[i] = pool_get(pool);
+        nodes[i]->val = i;
+    }
+    bench("pooled", nodes, nnodes, loops, 0);
+    bench("pooled", nodes, nnodes, loops, rounds);
+    for (u32 i = nnodes - 1; i > 0; --i) {
+        u32 j = bench_rand(&rnd) % (i + 1);
+        swap(nodes[i], nodes[j]);
+    }
+    bench("scattered", nodes, nnodes, loops, 0);
+    bench("scattered", nodes, nnodes, loops, rounds);
+    free(nodes);
+    pool_destroy(pool);
+    exit(0);
+}
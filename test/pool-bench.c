@@ -0,0 +1,684 @@
+/* pool-bench.c - pool benchmarks.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: pool-bench [-m MB] [bench...]
+ *
+ * Without argument, all benchmarks are run.
+ * -m: memory used by 'tlb' benchmark, in MB (default: 4096).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "pool.h"
+#include "arena.h"
+#include "bench.h"
+
+static size_t tlb_mb = 4096;
+
+/* freelist: compare list_head and POOL_SLIST free lists.
+ * - lifo:   get/release the same object, the free list head stays hot.
+ * - random: random get/release in a large window, so that free objects
+ *           (and their free list neighbours) are cold.
+ */
+static s64 freelist_lifo(pool_t *pool, u32 ops)
+{
+    s64 start = bench_ns();
+
+    for (u32 i = 0; i < ops; ++i) {
+        void *obj = pool_get(pool);
+        *(volatile char *)obj = 1;
+        pool_add(pool, obj);
+    }
+    return bench_ns() - start;
+}
+
+static s64 freelist_random(pool_t *pool, u32 ops, u32 window)
+{
+    void **slots = calloc(window, sizeof(*slots));
+    u64 rnd = 1;
+    s64 start, elapsed;
+
+    /* fill half window first, to scatter free list */
+    for (u32 i = 0; i < window; i += 2)
+        slots[i] = pool_get(pool);
+    start = bench_ns();
+    for (u32 i = 0; i < ops; ++i) {
+        u32 cur = bench_rand(&rnd) % window;
+        if (slots[cur]) {
+            pool_add(pool, slots[cur]);
+            slots[cur] = NULL;
+        } else {
+            slots[cur] = pool_get(pool);
+            *(volatile char *)slots[cur] = 1;
+        }
+    }
+    elapsed = bench_ns() - start;
+    for (u32 i = 0; i < window; ++i)
+        if (slots[i])
+            pool_add(pool, slots[i]);
+    free(slots);
+    return elapsed;
+}
+
+static void bench_freelist(void)
+{
+    static const size_t sizes[] = { 8, 16, 64, 256 };
+    static const struct {
+        char *name;
+        u32 flags;
+    } modes[] = {
+        { "list",  0 },
+        { "slist", POOL_SLIST },
+    };
+    u32 ops = 10000000, window = 1 << 20;
+
+    printf("freelist: %u ops, random window=%u\n", ops, window);
+    for (uint s = 0; s < ARRAY_SIZE(sizes); ++s) {
+        for (uint m = 0; m < ARRAY_SIZE(modes); ++m) {
+            pool_attr_t attr = { .flags = modes[m].flags };
+            pool_t *pool = pool_create_attr(modes[m].name, 4096, sizes[s], &attr);
+            s64 lifo, rnd;
+
+            bug_on_always(!pool);
+            lifo = freelist_lifo(pool, ops);
+            rnd = freelist_random(pool, ops, window);
+            printf("  %-6s eltsize=%-4zu (real=%-3zu) lifo=%6.2f ns/op  random=%6.2f ns/op\n",
+                   modes[m].name, sizes[s], pool->eltsize,
+                   (double) lifo / ops, (double) rnd / ops);
+            pool_destroy(pool);
+        }
+    }
+}
+
+/* growth: pool_get() latency, including the gets which grow the pool.
+ */
+static void bench_growth(void)
+{
+    static const u32 grows[] = { 1024, 65536, 1 << 20 };
+
+    printf("growth: pool_get() latency, eltsize=64\n");
+    for (uint g = 0; g < ARRAY_SIZE(grows); ++g) {
+        pool_t *pool = pool_create("growth", grows[g], 64);
+        u32 ops = grows[g] * 4;
+        s64 max = 0, total = 0;
+
+        bug_on_always(!pool);
+        for (u32 i = 0; i < ops; ++i) {
+            s64 start = bench_ns(), elapsed;
+            void *obj = pool_get(pool);
+            elapsed = bench_ns() - start;
+            bug_on_always(!obj);
+            total += elapsed;
+            if (elapsed > max)
+                max = elapsed;
+        }
+        printf("  growsize=%-8u gets=%-8u blocks=%u  mean=%6.2f ns  max=%9.3f us\n",
+               grows[g], ops, pool->nblocks, (double) total / ops, max / 1e3);
+        pool_destroy(pool);
+    }
+}
+
+/* stats: pool counters after a random get/release workload, on a standard
+ * and a POOL_MT pool. Needs a library compiled with POOL_STATS (and
+ * POOL_STATS_LATENCY for pool_get() latency histogram).
+ */
+static void bench_stats(void)
+{
+    static const struct {
+        char *name;
+        u32 flags;
+    } modes[] = {
+        { "list", 0 },
+        { "mt",   POOL_MT },
+    };
+    u32 ops = 10000000, window = 65536;
+
+    printf("stats: %u random gets/releases, window=%u, eltsize=64\n", ops, window);
+    for (uint m = 0; m < ARRAY_SIZE(modes); ++m) {
+        pool_attr_t attr = { .flags = modes[m].flags };
+        pool_t *pool = pool_create_attr(modes[m].name, 1024, 64, &attr);
+        void **slots = calloc(window, sizeof(*slots));
+        pool_counters_t counters;
+        u64 rnd = 1;
+
+        bug_on_always(!pool || !slots);
+        for (u32 i = 0; i < ops; ++i) {
+            u32 cur = bench_rand(&rnd) % window;
+            if (slots[cur]) {
+                pool_add(pool, slots[cur]);
+                slots[cur] = NULL;
+            } else {
+                slots[cur] = pool_get(pool);
+            }
+        }
+        if (pool_counters(pool, &counters)) {
+            printf("  %-5s counters not available (compile with POOL_STATS)\n",
+                   modes[m].name);
+        } else {
+            printf("  %-5s gets=%llu puts=%llu inuse=%llu hiwater=%llu grows=%llu "
+                   "(%.3f ms) reserved=%lluK\n", modes[m].name,
+                   (ullong) counters.gets, (ullong) counters.puts,
+                   (ullong) counters.inuse, (ullong) counters.hiwater,
+                   (ullong) counters.grows, counters.grow_ns / 1e6,
+                   (ullong) counters.reserved / 1024);
+            for (uint i = 0; i < POOL_LATENCY_BUCKETS; ++i)
+                if (counters.latency[i])
+                    printf("        get < %8lluns: %llu\n", 1ULL << i,
+                           (ullong) counters.latency[i]);
+        }
+        for (u32 i = 0; i < window; ++i)
+            if (slots[i])
+                pool_add(pool, slots[i]);
+        pool_destroy(pool);
+        free(slots);
+    }
+}
+
+/* harden: random get/release cost, with pools of increasing number of
+ * blocks. Run it with libraries compiled with and without POOL_HARDEN to
+ * measure hardened mode overhead: with POOL_HARDEN, objects are larger
+ * (red zone), and pool_add() scans the blocks list.
+ */
+static void bench_harden(void)
+{
+    static const u32 nblocks[] = { 1, 16, 256 };
+    static const struct {
+        char *name;
+        u32 flags;
+    } modes[] = {
+        { "list",    0 },
+        { "slist",   POOL_SLIST },
+        { "reclaim", POOL_RECLAIM },
+        { "mt",      POOL_MT },
+    };
+    u32 ops = 4000000, grow = 1024;
+
+    printf("harden: %u random gets/releases, eltsize=64\n", ops);
+    for (uint m = 0; m < ARRAY_SIZE(modes); ++m) {
+        for (uint b = 0; b < ARRAY_SIZE(nblocks); ++b) {
+            pool_attr_t attr = { .flags = modes[m].flags };
+            pool_t *pool = pool_create_attr(modes[m].name, grow, 64, &attr);
+            u32 window = nblocks[b] * grow;
+            s64 elapsed;
+
+            bug_on_always(!pool);
+            elapsed = freelist_random(pool, ops, window);
+            printf("  %-7s blocks=%-4u objsize=%zu eltsize=%-3zu %6.2f ns/op\n",
+                   modes[m].name, pool->nblocks, pool->objsize, pool->eltsize,
+                   (double) elapsed / ops);
+            pool_destroy(pool);
+        }
+    }
+}
+
+/* fixed: pool_get() latency after creation, for a growing pool, and for
+ * preallocated POOL_FIXED pools, with and without POOL_MLOCK.
+ */
+static void bench_fixed(void)
+{
+    static const struct {
+        char *name;
+        u32 flags;
+    } modes[] = {
+        { "grow",       0 },
+        { "fixed",      POOL_FIXED },
+        { "fixed-mmap", POOL_FIXED | POOL_MMAP },
+        { "mlock",      POOL_FIXED | POOL_MLOCK },
+        { "mlock-mmap", POOL_FIXED | POOL_MLOCK | POOL_MMAP },
+    };
+    u32 nobjs = 65536;
+
+    printf("fixed: %u gets after creation, eltsize=64\n", nobjs);
+    for (uint m = 0; m < ARRAY_SIZE(modes); ++m) {
+        pool_attr_t attr = { .flags = modes[m].flags };
+        s64 start = bench_ns(), create, max = 0, total = 0;
+        pool_t *pool = pool_create_attr(modes[m].name, nobjs, 64, &attr);
+        void *obj;
+
+        create = bench_ns() - start;
+        if (!pool) {
+            printf("  %-10s creation failed: %s\n", modes[m].name, strerror(errno));
+            continue;
+        }
+        for (u32 i = 0; i < nobjs; ++i) {
+            s64 elapsed;
+            start = bench_ns();
+            obj = pool_get(pool);
+            *(volatile char *)obj = 1;
+            elapsed = bench_ns() - start;
+            total += elapsed;
+            if (elapsed > max)
+                max = elapsed;
+        }
+        obj = pool_get(pool);
+        printf("  %-10s capacity=%-6u create=%8.3f ms  mean=%6.2f ns  max=%9.3f us  "
+               "next get: %s\n", modes[m].name, pool->growsize, create / 1e6,
+               (double) total / nobjs, max / 1e3, obj? "ok": strerror(errno));
+        pool_destroy(pool);
+    }
+}
+
+/* ctor: objects with embedded lists and a lock, initialized after every
+ * pool_get(), or kept constructed in pool with a constructor. With the
+ * constructor, the free list link is a dedicated field, large enough for
+ * both list and POOL_SLIST modes: constructed fields are checked after each
+ * pool_get().
+ */
+struct ctor_obj {
+    pthread_mutex_t lock;
+    struct list_head list;
+    struct list_head children;
+    u64 refs;
+    struct list_head link;
+    u64 data[8];
+};
+
+static void ctor_obj_init(void *p)
+{
+    struct ctor_obj *obj = p;
+
+    pthread_mutex_init(&obj->lock, NULL);
+    INIT_LIST_HEAD(&obj->list);
+    INIT_LIST_HEAD(&obj->children);
+    obj->refs = 0;
+    memset(obj->data, 0, sizeof(obj->data));
+}
+
+static void ctor_obj_fini(void *p)
+{
+    struct ctor_obj *obj = p;
+
+    pthread_mutex_destroy(&obj->lock);
+}
+
+static void ctor_obj_check(struct ctor_obj *obj)
+{
+    bug_on_always(obj->refs || !list_empty(&obj->list) ||
+                  !list_empty(&obj->children));
+    for (uint i = 0; i < ARRAY_SIZE(obj->data); ++i)
+        bug_on_always(obj->data[i]);
+}
+
+static s64 ctor_run(pool_t *pool, bool init, u32 ops, u32 window)
+{
+    struct ctor_obj **slots = calloc(window, sizeof(*slots));
+    u64 rnd = 1;
+    s64 start, elapsed;
+
+    start = bench_ns();
+    for (u32 i = 0; i < ops; ++i) {
+        u32 cur = bench_rand(&rnd) % window;
+        struct ctor_obj *obj = slots[cur];
+
+        if (obj) {
+            bug_on_always(obj->refs != 1 || !list_empty(&obj->children));
+            obj->refs = 0;
+            pool_add(pool, obj);
+            slots[cur] = NULL;
+        } else {
+            obj = pool_get(pool);
+            if (init)
+                ctor_obj_init(obj);
+            ctor_obj_check(obj);
+            pthread_mutex_lock(&obj->lock);
+            obj->refs = 1;
+            pthread_mutex_unlock(&obj->lock);
+            slots[cur] = obj;
+        }
+    }
+    elapsed = bench_ns() - start;
+    for (u32 i = 0; i < window; ++i)
+        if (slots[i]) {
+            slots[i]->refs = 0;
+            pool_add(pool, slots[i]);
+        }
+    free(slots);
+    return elapsed;
+}
+
+static void bench_ctor(void)
+{
+    static const u32 flags[] = { 0, POOL_SLIST };
+    u32 ops = 10000000, window = 4096;
+
+    printf("ctor: %u random gets/releases, window=%u, eltsize=%zu\n", ops,
+           window, sizeof(struct ctor_obj));
+    for (uint f = 0; f < ARRAY_SIZE(flags); ++f) {
+        pool_attr_t attr = {
+            .flags = flags[f],
+            .linkoff = offsetof(struct ctor_obj, link),
+            .ctor = ctor_obj_init,
+            .dtor = ctor_obj_fini,
+        };
+        pool_t *init = pool_create_attr("init", 1024, sizeof(struct ctor_obj),
+                                        &(pool_attr_t) { .flags = flags[f] });
+        pool_t *ctor = pool_create_attr("ctor", 1024, sizeof(struct ctor_obj),
+                                        &attr);
+        s64 t1, t2;
+
+        bug_on_always(!init || !ctor);
+        t1 = ctor_run(init, true, ops, window);
+        t2 = ctor_run(ctor, false, ops, window);
+        printf("  %-5s init on get=%6.2f ns/op  ctor=%6.2f ns/op\n",
+               flags[f]? "slist": "list", (double) t1 / ops, (double) t2 / ops);
+        pool_destroy(init);
+        pool_destroy(ctor);
+    }
+}
+
+/* tlb: random pointer chasing over a large pool, with malloc, mmap and
+ * huge pages blocks.
+ */
+struct tlb_obj {
+    struct tlb_obj *next;
+    u64 data[31];
+};
+
+static void bench_tlb(void)
+{
+    static const struct {
+        char *name;
+        u32 flags;
+    } modes[] = {
+        { "malloc",   0 },
+        { "mmap",     POOL_MMAP },
+        { "hugepage", POOL_HUGEPAGE },
+    };
+    u32 nobjs = tlb_mb * (1 << 20) / sizeof(struct tlb_obj);
+    u32 steps = 10000000;
+
+    printf("tlb: %zu MB, %u objects of %zu bytes, %u random accesses\n",
+           tlb_mb, nobjs, sizeof(struct tlb_obj), steps);
+    for (uint m = 0; m < ARRAY_SIZE(modes); ++m) {
+        pool_attr_t attr = { .flags = modes[m].flags };
+        pool_t *pool = pool_create_attr(modes[m].name, 1 << 18,
+                                        sizeof(struct tlb_obj), &attr);
+        struct tlb_obj **objs = malloc(nobjs * sizeof(*objs)), *cur;
+        u64 rnd = 1;
+        s64 start, elapsed;
+
+        bug_on_always(!pool || !objs);
+        for (u32 i = 0; i < nobjs; ++i) {
+            objs[i] = pool_get(pool);
+            bug_on_always(!objs[i]);
+        }
+        /* random cycle (Sattolo's algorithm) */
+        for (u32 i = nobjs - 1; i > 0; --i) {
+            u32 j = bench_rand(&rnd) % i;
+            swap(objs[i], objs[j]);
+        }
+        for (u32 i = 0; i < nobjs; ++i)
+            objs[i]->next = objs[(i + 1) % nobjs];
+        cur = objs[0];
+        free(objs);
+
+        start = bench_ns();
+        for (u32 i = 0; i < steps; ++i)
+            cur = cur->next;
+        elapsed = bench_ns() - start;
+        bug_on_always(!cur);
+        printf("  %-8s blocks=%-5u blocksize=%-10zu %6.2f ns/access\n",
+               modes[m].name, pool->nblocks, pool->blocksize,
+               (double) elapsed / steps);
+        pool_destroy(pool);
+    }
+}
+
+/* bulk: get/release batches of objects, with a pool_get()/pool_add() loop,
+ * and with pool_get_bulk()/pool_add_bulk().
+ */
+static s64 bulk_loop(pool_t *pool, void **objs, u32 batch, u32 ops)
+{
+    s64 start = bench_ns();
+
+    for (u32 n = 0; n < ops; n += batch) {
+        for (u32 i = 0; i < batch; ++i)
+            objs[i] = pool_get(pool);
+        for (u32 i = 0; i < batch; ++i)
+            *(volatile char *)objs[i] = 1;
+        for (u32 i = 0; i < batch; ++i)
+            pool_add(pool, objs[i]);
+    }
+    return bench_ns() - start;
+}
+
+static s64 bulk_bulk(pool_t *pool, void **objs, u32 batch, u32 ops)
+{
+    s64 start = bench_ns();
+
+    for (u32 n = 0; n < ops; n += batch) {
+        bug_on_always(pool_get_bulk(pool, objs, batch) != batch);
+        for (u32 i = 0; i < batch; ++i)
+            *(volatile char *)objs[i] = 1;
+        pool_add_bulk(pool, objs, batch);
+    }
+    return bench_ns() - start;
+}
+
+static void bench_bulk(void)
+{
+    static const u32 batches[] = { 32, 128, 256 };
+    static const struct {
+        char *name;
+        u32 flags;
+    } modes[] = {
+        { "list",  0 },
+        { "slist", POOL_SLIST },
+        { "mt",    POOL_MT },
+    };
+    u32 ops = 10000000;
+    void *objs[256];
+
+    printf("bulk: %u objects, eltsize=64\n", ops);
+    for (uint m = 0; m < ARRAY_SIZE(modes); ++m) {
+        for (uint b = 0; b < ARRAY_SIZE(batches); ++b) {
+            pool_attr_t attr = { .flags = modes[m].flags };
+            pool_t *pool = pool_create_attr(modes[m].name, 1024, 64, &attr);
+            s64 loop, bulk;
+
+            bug_on_always(!pool);
+            /* scatter free list */
+            bulk_bulk(pool, objs, batches[b], batches[b]);
+            loop = bulk_loop(pool, objs, batches[b], ops);
+            bulk = bulk_bulk(pool, objs, batches[b], ops);
+            printf("  %-6s batch=%-4u loop=%6.2f ns/obj  bulk=%6.2f ns/obj\n",
+                   modes[m].name, batches[b], (double) loop / ops,
+                   (double) bulk / ops);
+            pool_destroy(pool);
+        }
+    }
+}
+
+/* trim: allocate a burst of objects, release most of them, and trim pool.
+ */
+static size_t rss_kb(void)
+{
+    FILE *file = fopen("/proc/self/statm", "r");
+    unsigned long size, rss = 0;
+
+    if (file) {
+        if (fscanf(file, "%lu %lu", &size, &rss) != 2)
+            rss = 0;
+        fclose(file);
+    }
+    return rss * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+static void bench_trim(void)
+{
+    static const struct {
+        char *name;
+        u32 flags;
+    } modes[] = {
+        { "malloc", POOL_RECLAIM },
+        { "mmap",   POOL_RECLAIM | POOL_MMAP },
+        { "slist",  POOL_RECLAIM | POOL_SLIST },
+    };
+    u32 nobjs = 4 << 20, keep = nobjs / 100;
+
+    printf("trim: burst of %u objects of 64 bytes, %u kept\n", nobjs, keep);
+    for (uint m = 0; m < ARRAY_SIZE(modes); ++m) {
+        pool_attr_t attr = { .flags = modes[m].flags };
+        pool_t *pool = pool_create_attr(modes[m].name, 8192, 64, &attr);
+        void **objs = malloc(nobjs * sizeof(*objs));
+        size_t rss0 = rss_kb(), rss1, rss2, res;
+        u64 rnd = 1;
+        s64 start, elapsed;
+
+        bug_on_always(!pool || !objs);
+        bug_on_always(pool_get_bulk(pool, objs, nobjs) != nobjs);
+        for (u32 i = 0; i < nobjs; ++i)
+            memset(objs[i], 0, 64);
+        rss1 = rss_kb();
+        /* keep 1% of objects, packed in the first blocks */
+        for (u32 i = nobjs - 1; i > keep; --i) {
+            u32 j = keep + bench_rand(&rnd) % (i - keep + 1);
+            swap(objs[i], objs[j]);
+        }
+        for (u32 i = keep; i < nobjs; ++i)
+            pool_add(pool, objs[i]);
+        start = bench_ns();
+        res = pool_trim(pool, 0);
+        elapsed = bench_ns() - start;
+        rss2 = rss_kb();
+        printf("  %-6s blocks=%-4u rss: start=%zuK peak=%zuK after trim=%zuK  "
+               "reclaimed=%zuK in %.3fms\n", modes[m].name, pool->nblocks,
+               rss0, rss1, rss2, res / 1024, elapsed / 1e6);
+        for (u32 i = 0; i < keep; ++i)
+            pool_add(pool, objs[i]);
+        pool_stats(pool);
+        pool_destroy(pool);
+        free(objs);
+    }
+}
+
+/* arena: requests allocating @nobjs objects, all released at end of request,
+ * with pool_get()/pool_add(), with pool_add_bulk(), and with an arena, with
+ * arena_reset() and arena_rewind().
+ */
+static s64 arena_pool(pool_t *pool, void **objs, u32 nobjs, u32 ops, bool bulk)
+{
+    s64 start = bench_ns();
+
+    for (u32 n = 0; n < ops; n += nobjs) {
+        for (u32 i = 0; i < nobjs; ++i) {
+            objs[i] = pool_get(pool);
+            *(volatile char *)objs[i] = 1;
+        }
+        if (bulk) {
+            pool_add_bulk(pool, objs, nobjs);
+        } else {
+            for (u32 i = 0; i < nobjs; ++i)
+                pool_add(pool, objs[i]);
+        }
+    }
+    return bench_ns() - start;
+}
+
+static s64 arena_arena(arena_t *arena, u32 nobjs, u32 ops, bool rewind)
+{
+    arena_mark_t mark = arena_mark(arena);
+    s64 start = bench_ns();
+
+    for (u32 n = 0; n < ops; n += nobjs) {
+        for (u32 i = 0; i < nobjs; ++i) {
+            void *obj = arena_alloc(arena, 64);
+            *(volatile char *)obj = 1;
+        }
+        if (rewind)
+            arena_rewind(arena, mark);
+        else
+            arena_reset(arena);
+    }
+    return bench_ns() - start;
+}
+
+static void bench_arena(void)
+{
+    static const u32 sizes[] = { 32, 256, 4096 };
+    u32 ops = 10000000;
+    void **objs = malloc(4096 * sizeof(*objs));
+
+    printf("arena: %u objects, eltsize=64\n", ops);
+    for (uint s = 0; s < ARRAY_SIZE(sizes); ++s) {
+        pool_t *pool = pool_create("pool", 1024, 64);
+        arena_t *arena = arena_create("arena", 64 * 1024);
+        s64 loop, bulk, reset, rewind;
+
+        bug_on_always(!pool || !arena || !objs);
+        /* sizes which would overflow blocks size */
+        errno = 0;
+        bug_on_always(arena_alloc(arena, SIZE_MAX) || errno != ENOMEM);
+        bug_on_always(arena_alloc_align(arena, SIZE_MAX - 64, 4096));
+        /* warm up: populate pool and arena blocks */
+        arena_pool(pool, objs, sizes[s], sizes[s], true);
+        arena_alloc(arena, 1);
+        loop = arena_pool(pool, objs, sizes[s], ops, false);
+        bulk = arena_pool(pool, objs, sizes[s], ops, true);
+        reset = arena_arena(arena, sizes[s], ops, false);
+        arena_alloc(arena, 1);
+        rewind = arena_arena(arena, sizes[s], ops, true);
+        printf("  objs/request=%-5u pool=%6.2f pool-bulk=%6.2f arena-reset=%6.2f "
+               "arena-rewind=%6.2f ns/obj\n", sizes[s], (double) loop / ops,
+               (double) bulk / ops, (double) reset / ops, (double) rewind / ops);
+        pool_destroy(pool);
+        arena_destroy(arena);
+    }
+    free(objs);
+}
+
+static const struct {
+    char *name;
+    void (*func)(void);
+} benchs[] = {
+    { "freelist", bench_freelist },
+    { "growth",   bench_growth },
+    { "stats",    bench_stats },
+    { "harden",   bench_harden },
+    { "fixed",    bench_fixed },
+    { "ctor",     bench_ctor },
+    { "tlb",      bench_tlb },
+    { "bulk",     bench_bulk },
+    { "trim",     bench_trim },
+    { "arena",    bench_arena },
+};
+
+int main(int ac, char **av)
+{
+    int opt;
+
+    while ((opt = getopt(ac, av, "m:")) != -1) {
+        switch (opt) {
+            case 'm':
+                tlb_mb = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-m MB] [bench...]\n", *av);
+                exit(1);
+        }
+    }
+    for (uint i = 0; i < ARRAY_SIZE(benchs); ++i) {
+        bool run = optind == ac;
+        for (int j = optind; j < ac; ++j)
+            if (!strcmp(av[j], benchs[i].name))
+                run = true;
+        if (run)
+            benchs[i].func();
+    }
+    exit(0);
+}
@@ -0,0 +1,418 @@
+/* pool-mt-bench.c - multi-threaded pool stress test & benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: pool-mt-bench [-b bench] [-o ops] [-w window] [nthreads...]
+ *
+ * stress: each thread randomly gets/releases objects in a private window of
+ * @window slots, @ops times. This is done with:
+ *   - lock: a standard pool, protected by a global mutex.
+ *   - mt:   a POOL_MT pool.
+ *   - lockfree: a POOL_LOCKFREE pool.
+ * Objects are stamped on get and checked on release.
+ *
+ * bulk: each thread gets batches of @window objects with pool_get_bulk(),
+ * stamps and checks them, and releases them with pool_add_bulk(), on a
+ * POOL_MT pool.
+ *
+ * counters: each thread gets one 8 bytes counter from a pool, and increments
+ * it @ops times, with packed objects and with POOL_CACHELINE objects. Packed
+ * counters share cache lines, and suffer from false sharing.
+ *
+ * pipeline: @nthreads / 2 producer threads get objects and pass them to as
+ * many consumer threads (through single-producer/single-consumer rings),
+ * which check and release them: all objects are released by another thread
+ * than the one which got them. @ops objects are transferred in total. This is
+ * done with:
+ *   - lock:     a standard pool, protected by a global mutex.
+ *   - mt:       a POOL_MT pool.
+ *   - lockfree: a POOL_LOCKFREE pool.
+ *
+ * Without -b option, all benchmarks are run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "pool.h"
+#include "bench.h"
+
+struct obj {
+    u32 owner;
+    u32 seq;
+    char payload[40];
+};
+
+struct thread_arg {
+    pthread_t thread;
+    u32 id;
+    u32 ops;
+    u32 window;
+    pool_t *pool;
+    bool lock;
+    u64 errors;
+};
+
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline struct obj *obj_get(struct thread_arg *arg)
+{
+    struct obj *obj;
+
+    if (arg->lock) {
+        pthread_mutex_lock(&global_lock);
+        obj = pool_get(arg->pool);
+        pthread_mutex_unlock(&global_lock);
+    } else {
+        obj = pool_get(arg->pool);
+    }
+    return obj;
+}
+
+static inline void obj_add(struct thread_arg *arg, struct obj *obj)
+{
+    if (arg->lock) {
+        pthread_mutex_lock(&global_lock);
+        pool_add(arg->pool, obj);
+        pthread_mutex_unlock(&global_lock);
+    } else {
+        pool_add(arg->pool, obj);
+    }
+}
+
+static void *worker(void *p)
+{
+    struct thread_arg *arg = p;
+    struct obj **slots = calloc(arg->window, sizeof(*slots));
+    u64 rnd = 0x9E3779B97F4A7C15ULL * (arg->id + 1);
+
+    for (u32 i = 0; i < arg->ops; ++i) {
+        u32 cur = bench_rand(&rnd) % arg->window;
+        struct obj *obj = slots[cur];
+
+        if (obj) {
+            if (obj->owner != arg->id || obj->seq != cur)
+                arg->errors++;
+            obj_add(arg, obj);
+            slots[cur] = NULL;
+        } else {
+            obj = obj_get(arg);
+            bug_on_always(!obj);
+            obj->owner = arg->id;
+            obj->seq = cur;
+            slots[cur] = obj;
+        }
+    }
+    for (u32 i = 0; i < arg->window; ++i)
+        if (slots[i])
+            obj_add(arg, slots[i]);
+    free(slots);
+    return NULL;
+}
+
+static void stress(const char *name, u32 flags, bool lock, u32 nthreads,
+                   u32 ops, u32 window)
+{
+    pool_attr_t attr = { .flags = flags };
+    pool_t *pool = pool_create_attr(name, 1024, sizeof(struct obj), &attr);
+    struct thread_arg *args = calloc(nthreads, sizeof(*args));
+    u64 errors = 0;
+    s64 start, elapsed;
+
+    bug_on_always(!pool || !args);
+    start = bench_ns();
+    for (u32 i = 0; i < nthreads; ++i) {
+        args[i] = (struct thread_arg) {
+            .id = i, .ops = ops, .window = window, .pool = pool, .lock = lock
+        };
+        pthread_create(&args[i].thread, NULL, worker, args + i);
+    }
+    for (u32 i = 0; i < nthreads; ++i) {
+        pthread_join(args[i].thread, NULL);
+        errors += args[i].errors;
+    }
+    elapsed = bench_ns() - start;
+    printf("%-8s threads=%-3u ops=%-10llu time=%8.3fms  %8.2f Mops/s  errors=%llu\n",
+           name, nthreads, (ullong) ops * nthreads, elapsed / 1e6,
+           bench_mops((u64) ops * nthreads, elapsed), (ullong) errors);
+    bug_on_always(errors);
+    pool_stats(pool);
+    pool_destroy(pool);
+    free(args);
+}
+
+static void bench_stress(u32 nthreads, u32 ops, u32 window)
+{
+    stress("lock", 0, true, nthreads, ops, window);
+    stress("mt", POOL_MT, false, nthreads, ops, window);
+    stress("lockfree", POOL_LOCKFREE, false, nthreads, ops, window);
+}
+
+static void *bulk_worker(void *p)
+{
+    struct thread_arg *arg = p;
+    struct obj **objs = calloc(arg->window, sizeof(*objs));
+
+    for (u32 n = 0; n < arg->ops; n += arg->window) {
+        u32 got = pool_get_bulk(arg->pool, (void **)objs, arg->window);
+        bug_on_always(got != arg->window);
+        for (u32 i = 0; i < got; ++i) {
+            objs[i]->owner = arg->id;
+            objs[i]->seq = i;
+        }
+        for (u32 i = 0; i < got; ++i)
+            if (objs[i]->owner != arg->id || objs[i]->seq != i)
+                arg->errors++;
+        pool_add_bulk(arg->pool, (void **)objs, got);
+    }
+    free(objs);
+    return NULL;
+}
+
+static void bench_bulk(u32 nthreads, u32 ops, u32 window)
+{
+    pool_attr_t attr = { .flags = POOL_MT };
+    pool_t *pool = pool_create_attr("bulk", 1024, sizeof(struct obj), &attr);
+    struct thread_arg *args = calloc(nthreads, sizeof(*args));
+    u64 errors = 0;
+    s64 start, elapsed;
+
+    bug_on_always(!pool || !args);
+    start = bench_ns();
+    for (u32 i = 0; i < nthreads; ++i) {
+        args[i] = (struct thread_arg) {
+            .id = i, .ops = ops, .window = window, .pool = pool
+        };
+        pthread_create(&args[i].thread, NULL, bulk_worker, args + i);
+    }
+    for (u32 i = 0; i < nthreads; ++i) {
+        pthread_join(args[i].thread, NULL);
+        errors += args[i].errors;
+    }
+    elapsed = bench_ns() - start;
+    printf("bulk  threads=%-3u ops=%-10llu time=%8.3fms  %8.2f Mops/s  errors=%llu\n",
+           nthreads, (ullong) ops * nthreads, elapsed / 1e6,
+           bench_mops((u64) ops * nthreads, elapsed), (ullong) errors);
+    bug_on_always(errors);
+    pool_destroy(pool);
+    free(args);
+}
+
+struct counter_arg {
+    pthread_t thread;
+    volatile u64 *counter;
+    u32 ops;
+};
+
+static void *counter_worker(void *p)
+{
+    struct counter_arg *arg = p;
+
+    for (u32 i = 0; i < arg->ops; ++i)
+        (*arg->counter)++;
+    return NULL;
+}
+
+static void counters(const char *name, u32 flags, u32 nthreads, u32 ops)
+{
+    pool_attr_t attr = { .flags = flags };
+    pool_t *pool = pool_create_attr(name, 64, sizeof(u64), &attr);
+    struct counter_arg *args = calloc(nthreads, sizeof(*args));
+    s64 start, elapsed;
+
+    bug_on_always(!pool || !args);
+    for (u32 i = 0; i < nthreads; ++i) {
+        args[i].counter = pool_get(pool);
+        bug_on_always((uintptr_t)args[i].counter % pool->align);
+        *args[i].counter = 0;
+        args[i].ops = ops;
+    }
+    start = bench_ns();
+    for (u32 i = 0; i < nthreads; ++i)
+        pthread_create(&args[i].thread, NULL, counter_worker, args + i);
+    for (u32 i = 0; i < nthreads; ++i)
+        pthread_join(args[i].thread, NULL);
+    elapsed = bench_ns() - start;
+    for (u32 i = 0; i < nthreads; ++i)
+        bug_on_always(*args[i].counter != ops);
+    printf("%-9s threads=%-3u eltsize=%-3zu time=%8.3fms  %8.2f Mops/s\n",
+           name, nthreads, pool->eltsize, elapsed / 1e6,
+           bench_mops((u64) ops * nthreads, elapsed));
+    pool_destroy(pool);
+    free(args);
+}
+
+static void bench_counters(u32 nthreads, u32 ops, __unused u32 window)
+{
+    counters("packed", POOL_SLIST, nthreads, ops);
+    counters("cacheline", POOL_SLIST | POOL_CACHELINE, nthreads, ops);
+}
+
+#define RING_SIZE 1024                            /* pipeline ring size (power of 2) */
+
+struct ring {
+    u64 head __aligned(64);                       /* next slot to consume */
+    u64 tail __aligned(64);                       /* next slot to produce */
+    struct obj *slots[RING_SIZE] __aligned(64);
+};
+
+struct pipe_arg {
+    struct thread_arg arg;                        /* id, ops, pool, lock, errors */
+    struct ring *ring;                            /* producer -> consumer ring */
+};
+
+static void ring_put(struct ring *ring, struct obj *obj)
+{
+    u64 tail = ring->tail;
+
+    while (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == RING_SIZE)
+        sched_yield();
+    ring->slots[tail % RING_SIZE] = obj;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static struct obj *ring_get(struct ring *ring)
+{
+    u64 head = ring->head;
+    struct obj *obj;
+
+    while (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))
+        sched_yield();
+    obj = ring->slots[head % RING_SIZE];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return obj;
+}
+
+static void *producer(void *p)
+{
+    struct pipe_arg *pipe = p;
+    struct thread_arg *arg = &pipe->arg;
+
+    for (u32 i = 0; i < arg->ops; ++i) {
+        struct obj *obj = obj_get(arg);
+        bug_on_always(!obj);
+        obj->owner = arg->id;
+        obj->seq = i;
+        ring_put(pipe->ring, obj);
+    }
+    ring_put(pipe->ring, NULL);
+    return NULL;
+}
+
+static void *consumer(void *p)
+{
+    struct pipe_arg *pipe = p;
+    struct thread_arg *arg = &pipe->arg;
+    struct obj *obj;
+
+    for (u32 seq = 0; (obj = ring_get(pipe->ring)); ++seq) {
+        if (obj->owner != arg->id || obj->seq != seq)
+            arg->errors++;
+        obj_add(arg, obj);
+    }
+    return NULL;
+}
+
+static void pipeline(const char *name, u32 flags, bool lock, u32 npairs, u32 ops)
+{
+    pool_attr_t attr = { .flags = flags };
+    pool_t *pool = pool_create_attr(name, 1024, sizeof(struct obj), &attr);
+    struct pipe_arg *args = calloc(npairs * 2, sizeof(*args));
+    struct ring *rings = aligned_alloc(64, npairs * sizeof(*rings));
+    u64 errors = 0;
+    s64 start, elapsed;
+
+    bug_on_always(!pool || !args || !rings);
+    memset(rings, 0, npairs * sizeof(*rings));
+    start = bench_ns();
+    for (u32 i = 0; i < npairs * 2; ++i) {
+        args[i] = (struct pipe_arg) {
+            .arg = { .id = i / 2, .ops = ops / npairs, .pool = pool, .lock = lock },
+            .ring = rings + i / 2
+        };
+        pthread_create(&args[i].arg.thread, NULL, i % 2? consumer: producer,
+                       args + i);
+    }
+    for (u32 i = 0; i < npairs * 2; ++i) {
+        pthread_join(args[i].arg.thread, NULL);
+        errors += args[i].arg.errors;
+    }
+    elapsed = bench_ns() - start;
+    printf("%-8s threads=%-3u ops=%-10u time=%8.3fms  %8.2f Mops/s  errors=%llu\n",
+           name, npairs * 2, ops / npairs * npairs, elapsed / 1e6,
+           bench_mops(ops / npairs * npairs, elapsed), (ullong) errors);
+    bug_on_always(errors);
+    pool_destroy(pool);
+    free(rings);
+    free(args);
+}
+
+static void bench_pipeline(u32 nthreads, u32 ops, __unused u32 window)
+{
+    if (nthreads < 2)
+        return;
+    pipeline("lock", 0, true, nthreads / 2, ops);
+    pipeline("mt", POOL_MT, false, nthreads / 2, ops);
+    pipeline("lockfree", POOL_LOCKFREE, false, nthreads / 2, ops);
+}
+
+static const struct {
+    char *name;
+    void (*func)(u32 nthreads, u32 ops, u32 window);
+} benchs[] = {
+    { "stress",   bench_stress },
+    { "bulk",     bench_bulk },
+    { "counters", bench_counters },
+    { "pipeline", bench_pipeline },
+};
+
+int main(int ac, char **av)
+{
+    static const u32 deflt[] = { 1, 2, 4, 8, 16, 32 };
+    u32 ops = 4000000, window = 512;
+    char *bench = NULL;
+    int opt;
+
+    while ((opt = getopt(ac, av, "b:o:w:")) != -1) {
+        switch (opt) {
+            case 'b':
+                bench = optarg;
+                break;
+            case 'o':
+                ops = atoi(optarg);
+                break;
+            case 'w':
+                window = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-b bench] [-o ops] [-w window] [nthreads...]\n",
+                        *av);
+                exit(1);
+        }
+    }
+    for (uint b = 0; b < ARRAY_SIZE(benchs); ++b) {
+        if (bench && strcmp(bench, benchs[b].name))
+            continue;
+        if (optind == ac) {
+            for (uint i = 0; i < ARRAY_SIZE(deflt); ++i)
+                benchs[b].func(deflt[i], ops, window);
+        } else {
+            for (int i = optind; i < ac; ++i)
+                benchs[b].func(atoi(av[i]), ops, window);
+        }
+    }
+    exit(0);
+}
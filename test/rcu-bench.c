@@ -0,0 +1,223 @@
+/* rcu-bench.c - RCU hashtable readers stress test & benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: rcu-bench [-o ops] [-k keys] [-u usecs] [nthreads...]
+ *
+ * A hashtable holds @keys objects. @nthreads reader threads each look up
+ * @ops random keys, and check the objects found, while one writer thread
+ * replaces a random object every @usecs microseconds. This is done with:
+ *   - rwlock: readers and writer take a pthread rwlock, replaced objects are
+ *             freed immediately.
+ *   - rcu:    readers use rcu_read_lock(), the writer uses hlist_replace_rcu()
+ *             and frees replaced objects with call_rcu().
+ * Freed objects are poisoned first, so that a premature free is detected by
+ * readers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "hashtable.h"
+#include "rculist.h"
+#include "rcu.h"
+#include "bench.h"
+
+#define HT_BITS 16
+#define POISON  0xdeadbeefdeadbeefULL
+
+struct obj {
+    u64 key;
+    u64 val;                                      /* key * 3, or POISON */
+    struct hlist_node hlist;
+    struct rcu_head rcu;
+};
+
+static DEFINE_HASHTABLE(ht, HT_BITS);
+static pthread_rwlock_t ht_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t ht_wlock = PTHREAD_MUTEX_INITIALIZER;
+
+struct thread_arg {
+    pthread_t thread;
+    u32 id;
+    u32 ops;
+    u32 keys;
+    bool rcu;
+    u64 errors;
+};
+
+static volatile bool writer_stop;
+
+static struct obj *obj_new(u64 key)
+{
+    struct obj *obj = malloc(sizeof(*obj));
+
+    obj->key = key;
+    obj->val = key * 3;
+    return obj;
+}
+
+static void obj_free(struct obj *obj)
+{
+    WRITE_ONCE(obj->val, POISON);
+    free(obj);
+}
+
+static void obj_free_rcu(struct rcu_head *head)
+{
+    obj_free(container_of(head, struct obj, rcu));
+}
+
+static inline struct obj *lookup(u64 key)
+{
+    struct obj *obj;
+
+    hash_for_each_possible_rcu(ht, obj, hlist, key)
+        if (obj->key == key)
+            return obj;
+    return NULL;
+}
+
+static void *reader(void *p)
+{
+    struct thread_arg *arg = p;
+    u64 rnd = arg->id + 1;
+
+    for (u32 i = 0; i < arg->ops; ++i) {
+        u64 key = bench_rand(&rnd) % arg->keys;
+        struct obj *obj;
+
+        if (arg->rcu)
+            rcu_read_lock();
+        else
+            pthread_rwlock_rdlock(&ht_rwlock);
+        obj = lookup(key);
+        if (!obj || READ_ONCE(obj->val) != key * 3)
+            arg->errors++;
+        if (arg->rcu)
+            rcu_read_unlock();
+        else
+            pthread_rwlock_unlock(&ht_rwlock);
+    }
+    return NULL;
+}
+
+static void *writer(void *p)
+{
+    struct thread_arg *arg = p;
+    u64 rnd = 0x9E3779B97F4A7C15ULL;
+
+    while (!writer_stop) {
+        u64 key = bench_rand(&rnd) % arg->keys;
+        struct obj *new = obj_new(key), *old;
+
+        if (arg->rcu) {
+            pthread_mutex_lock(&ht_wlock);
+            old = lookup(key);
+            hlist_replace_rcu(&old->hlist, &new->hlist);
+            pthread_mutex_unlock(&ht_wlock);
+            call_rcu(&old->rcu, obj_free_rcu);
+        } else {
+            pthread_rwlock_wrlock(&ht_rwlock);
+            old = lookup(key);
+            hlist_replace_rcu(&old->hlist, &new->hlist);
+            pthread_rwlock_unlock(&ht_rwlock);
+            obj_free(old);
+        }
+        arg->errors++;                            /* updates count */
+        if (arg->ops)
+            usleep(arg->ops);
+    }
+    return NULL;
+}
+
+static void bench(u32 nthreads, u32 ops, u32 keys, u32 usecs, bool rcu)
+{
+    struct thread_arg *args = calloc(nthreads + 1, sizeof(*args));
+    struct thread_arg *warg = args + nthreads;
+    struct hlist_node *tmp;
+    struct obj *obj;
+    u64 errors = 0;
+    s64 start, elapsed;
+    uint bkt;
+
+    for (u64 k = 0; k < keys; ++k) {
+        obj = obj_new(k);
+        hash_add(ht, &obj->hlist, k);
+    }
+    writer_stop = false;
+    *warg = (struct thread_arg) { .ops = usecs, .keys = keys, .rcu = rcu };
+    pthread_create(&warg->thread, NULL, writer, warg);
+    start = bench_ns();
+    for (u32 t = 0; t < nthreads; ++t) {
+        args[t] = (struct thread_arg) { .id = t, .ops = ops, .keys = keys, .rcu = rcu };
+        pthread_create(&args[t].thread, NULL, reader, args + t);
+    }
+    for (u32 t = 0; t < nthreads; ++t) {
+        pthread_join(args[t].thread, NULL);
+        errors += args[t].errors;
+    }
+    elapsed = bench_ns() - start;
+    writer_stop = true;
+    pthread_join(warg->thread, NULL);
+    rcu_barrier();
+
+    printf("%-6s threads=%-3u lookups=%-9lu updates=%-7lu time=%8.3fms  "
+           "%8.2f Mops/s  %7.2f Mops/s/thread  errors=%lu\n",
+           rcu? "rcu": "rwlock", nthreads, (u64) ops * nthreads, warg->errors,
+           elapsed / 1e6, bench_mops((u64) ops * nthreads, elapsed),
+           bench_mops(ops, elapsed), errors);
+    bug_on_always(errors);
+
+    hash_for_each_safe(ht, bkt, tmp, obj, hlist) {
+        hash_del(&obj->hlist);
+        free(obj);
+    }
+    free(args);
+}
+
+int main(int ac, char **av)
+{
+    static const u32 deflt[] = { 1, 2, 4, 8 };
+    u32 ops = 4000000, keys = 1 << 16, usecs = 50;
+    int opt;
+
+    while ((opt = getopt(ac, av, "o:k:u:")) != -1) {
+        switch (opt) {
+            case 'o':
+                ops = atoi(optarg);
+                break;
+            case 'k':
+                keys = atoi(optarg);
+                break;
+            case 'u':
+                usecs = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-o ops] [-k keys] [-u usecs] [nthreads...]\n",
+                        *av);
+                exit(1);
+        }
+    }
+    for (int rcu = 0; rcu < 2; ++rcu) {
+        if (optind == ac) {
+            for (uint i = 0; i < ARRAY_SIZE(deflt); ++i)
+                bench(deflt[i], ops, keys, usecs, rcu);
+        } else {
+            for (int i = optind; i < ac; ++i)
+                bench(atoi(av[i]), ops, keys, usecs, rcu);
+        }
+    }
+    exit(0);
+}
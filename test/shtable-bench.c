@@ -0,0 +1,241 @@
+/* shtable-bench.c - sharded hashtable YCSB-style benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: shtable-bench [-o ops] [-k keys] [-s shardbits] [nthreads...]
+ *
+ * Tables sizes are first checked: bad ones must fail with EINVAL.
+ * A table is loaded with @keys records, then each thread runs @ops operations,
+ * reads or updates, on keys following a YCSB "hotspot" distribution: 80% of
+ * operations access 20% of the keys. Workloads are:
+ *   - read-heavy:  95% reads, 5% updates (YCSB B).
+ *   - balanced:    50% reads, 50% updates (YCSB A).
+ *   - write-heavy: 5% reads, 95% updates.
+ * A record holds a value and its complement, written together by updates:
+ * reads check that they are consistent. Tables are:
+ *   - global:  one shard with a rwlock, i.e. a globally locked table.
+ *   - rwlock:  2^@shardbits shards with rwlocks.
+ *   - seqlock: 2^@shardbits shards with seqlocks and RCU readers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "bitops.h"
+#include "shtable.h"
+#include "rcu.h"
+#include "bench.h"
+
+struct record {
+    u64 key;
+    u64 val;
+    u64 check;                                    /* ~val */
+    struct hlist_node hlist;
+};
+
+static const struct workload {
+    char *name;
+    u32 read;                                     /* read percentage */
+} workloads[] = {
+    { "read-heavy",  95 },
+    { "balanced",    50 },
+    { "write-heavy",  5 },
+};
+
+static const struct table {
+    char *name;
+    bool sharded;
+    u32 flags;
+} tables[] = {
+    { "global",  false, 0 },
+    { "rwlock",  true,  0 },
+    { "seqlock", true,  SHTABLE_SEQLOCK },
+};
+
+struct thread_arg {
+    pthread_t thread;
+    shtable_t *table;
+    u32 id;
+    u32 ops;
+    u32 keys;
+    u32 read;
+    u64 errors;
+};
+
+static u64 record_key(const struct hlist_node *node)
+{
+    return hlist_entry(node, struct record, hlist)->key;
+}
+
+static void record_free(struct hlist_node *node)
+{
+    free(hlist_entry(node, struct record, hlist));
+}
+
+static void record_read(struct hlist_node *node, void *arg)
+{
+    struct record *rec = hlist_entry(node, struct record, hlist);
+    u64 *copy = arg;
+
+    copy[0] = READ_ONCE(rec->val);
+    copy[1] = READ_ONCE(rec->check);
+}
+
+static void record_update(struct hlist_node *node, void *arg)
+{
+    struct record *rec = hlist_entry(node, struct record, hlist);
+    u64 val = *(u64 *)arg;
+
+    WRITE_ONCE(rec->val, val);
+    WRITE_ONCE(rec->check, ~val);
+}
+
+/* hotspot distribution: 80% of keys in the first 20%.
+ */
+static inline u64 hotspot(u64 *rnd, u32 keys)
+{
+    u64 r = bench_rand(rnd);
+    u32 hot = keys / 5;
+
+    if (r % 100 < 80)
+        return (r >> 32) % hot;
+    return hot + (r >> 32) % (keys - hot);
+}
+
+static void *worker(void *p)
+{
+    struct thread_arg *arg = p;
+    u64 rnd = arg->id + 1;
+
+    for (u32 i = 0; i < arg->ops; ++i) {
+        u64 key = hotspot(&rnd, arg->keys);
+
+        if (bench_rand(&rnd) % 100 < arg->read) {
+            u64 copy[2];
+
+            if (!shtable_lookup(arg->table, key, record_read, copy) ||
+                copy[1] != ~copy[0])
+                arg->errors++;
+        } else {
+            u64 val = bench_rand(&rnd);
+
+            if (!shtable_update(arg->table, key, record_update, &val))
+                arg->errors++;
+        }
+    }
+    return NULL;
+}
+
+static void check_create(void)
+{
+    static const u32 bad[][2] = { { 0, 0 }, { 20, 13 }, { 32, 0 }, { 0, 32 },
+                                  { 0xffffffff, 2 } };
+    shtable_t *t;
+
+    for (uint i = 0; i < ARRAY_SIZE(bad); ++i) {
+        errno = 0;
+        bug_on_always(shtable_create(bad[i][0], bad[i][1], 0, record_key) ||
+                      errno != EINVAL);
+    }
+    bug_on_always(!(t = shtable_create(0, 1, SHTABLE_SEQLOCK, record_key)));
+    shtable_destroy(t, NULL);
+}
+
+static void bench(const struct table *table, const struct workload *workload,
+                  u32 nthreads, u32 ops, u32 keys, u32 shardbits)
+{
+    struct thread_arg *args = calloc(nthreads, sizeof(*args));
+    u32 sbits = table->sharded? shardbits: 0;
+    /* about 2 buckets per key */
+    u32 bbits = max((s32) ilog2_32(keys) + 1 - (s32) sbits, 0);
+    shtable_t *t = shtable_create(sbits, bbits, table->flags, record_key);
+    shtable_stats_t stats;
+    u64 errors = 0, maxcount = 0, maxchain = 0;
+    s64 start, elapsed;
+
+    bug_on_always(!t);
+    for (u32 k = 0; k < keys; ++k) {
+        struct record *rec = malloc(sizeof(*rec));
+
+        rec->key = k;
+        rec->val = k;
+        rec->check = ~rec->val;
+        bug_on_always(shtable_add(t, &rec->hlist));
+    }
+    start = bench_ns();
+    for (u32 i = 0; i < nthreads; ++i) {
+        args[i] = (struct thread_arg) {
+            .table = t, .id = i, .ops = ops, .keys = keys, .read = workload->read
+        };
+        pthread_create(&args[i].thread, NULL, worker, args + i);
+    }
+    for (u32 i = 0; i < nthreads; ++i) {
+        pthread_join(args[i].thread, NULL);
+        errors += args[i].errors;
+    }
+    elapsed = bench_ns() - start;
+
+    for (u32 s = 0; s < 1U << sbits; ++s) {
+        shtable_shard_stats(t, s, &stats);
+        maxcount = max(maxcount, stats.count);
+        maxchain = max(maxchain, stats.maxchain);
+    }
+    printf("%-11s %-7s threads=%-3u ops=%-9lu time=%8.3fms  %8.2f Mops/s  "
+           "shards=%-4u max shard=%-8lu max chain=%-3lu errors=%lu\n",
+           workload->name, table->name, nthreads, (u64) ops * nthreads,
+           elapsed / 1e6, bench_mops((u64) ops * nthreads, elapsed), 1U << sbits,
+           maxcount, maxchain, errors);
+    bug_on_always(errors);
+    shtable_destroy(t, record_free);
+    free(args);
+}
+
+int main(int ac, char **av)
+{
+    static const u32 deflt[] = { 1, 2, 4, 8 };
+    u32 ops = 1000000, keys = 1 << 20, shardbits = 6;
+    int opt;
+
+    while ((opt = getopt(ac, av, "o:k:s:")) != -1) {
+        switch (opt) {
+            case 'o':
+                ops = atoi(optarg);
+                break;
+            case 'k':
+                keys = atoi(optarg);
+                break;
+            case 's':
+                shardbits = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-o ops] [-k keys] [-s shardbits] [nthreads...]\n",
+                        *av);
+                exit(1);
+        }
+    }
+    check_create();
+    for (uint w = 0; w < ARRAY_SIZE(workloads); ++w) {
+        for (uint t = 0; t < ARRAY_SIZE(tables); ++t) {
+            if (optind == ac) {
+                for (uint i = 0; i < ARRAY_SIZE(deflt); ++i)
+                    bench(tables + t, workloads + w, deflt[i], ops, keys, shardbits);
+            } else {
+                for (int i = optind; i < ac; ++i)
+                    bench(tables + t, workloads + w, atoi(av[i]), ops, keys, shardbits);
+            }
+        }
+    }
+    exit(0);
+}
@@ -0,0 +1,188 @@
+/* swiss-bench.c - Swiss table vs hashtable.h benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: swiss-bench [-n keys]
+ *
+ * u64 keys and values are inserted in, looked up in random order (hit and
+ * miss), and erased from:
+ *   - hashtable: a DEFINE_HASHTABLE table of 2^20 buckets, indexed with
+ *                hash_min(), nodes from a pool.
+ *   - swiss:     a Swiss table, without and with size hint.
+ * Tables contents are checked.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "hashtable.h"
+#include "pool.h"
+#include "swiss.h"
+#include "bench.h"
+
+struct node {
+    u64 key;
+    u64 val;
+    struct hlist_node hlist;
+};
+
+static DEFINE_HASHTABLE(ht, 20);
+
+static void result(char *table, char *op, u32 n, s64 elapsed)
+{
+    printf("%-10s %-11s keys=%-9u time=%8.3fms  %6.1f ns/op\n", table, op, n,
+           elapsed / 1e6, (double) elapsed / n);
+}
+
+static struct node *ht_find(u64 key)
+{
+    struct node *node;
+
+    hash_for_each_possible(ht, node, hlist, key)
+        if (node->key == key)
+            return node;
+    return NULL;
+}
+
+static void bench_hashtable(u64 *keys, u64 *lookups, u64 *misses, u32 n)
+{
+    pool_t *pool = pool_create("nodes", 4096, sizeof(struct node));
+    s64 start;
+
+    start = bench_ns();
+    for (u32 i = 0; i < n; ++i) {
+        struct node *node = pool_get(pool);
+        node->key = keys[i];
+        node->val = keys[i] * 3;
+        hash_add(ht, &node->hlist, node->key);
+    }
+    result("hashtable", "insert", n, bench_ns() - start);
+
+    start = bench_ns();
+    for (u32 i = 0; i < n; ++i) {
+        struct node *node = ht_find(lookups[i]);
+        bug_on_always(!node || node->val != lookups[i] * 3);
+    }
+    result("hashtable", "lookup hit", n, bench_ns() - start);
+
+    start = bench_ns();
+    for (u32 i = 0; i < n; ++i)
+        bug_on_always(ht_find(misses[i]));
+    result("hashtable", "lookup miss", n, bench_ns() - start);
+
+    start = bench_ns();
+    for (u32 i = 0; i < n; ++i) {
+        struct node *node = ht_find(keys[i]);
+        hash_del(&node->hlist);
+        pool_add(pool, node);
+    }
+    result("hashtable", "erase", n, bench_ns() - start);
+    bug_on_always(!hash_empty(ht));
+    pool_destroy(pool);
+}
+
+static void bench_swiss(u64 *keys, u64 *lookups, u64 *misses, u32 n, bool hint)
+{
+    swiss_t *t = swiss_create(sizeof(u64), sizeof(u64), hint? n: 0, NULL, NULL);
+    char *name = hint? "swiss-hint": "swiss";
+    s64 start;
+
+    start = bench_ns();
+    for (u32 i = 0; i < n; ++i) {
+        u64 val = keys[i] * 3;
+        swiss_put(t, keys + i, &val);
+    }
+    result(name, "insert", n, bench_ns() - start);
+    bug_on_always(swiss_count(t) != n);
+
+    start = bench_ns();
+    for (u32 i = 0; i < n; ++i) {
+        u64 *val = swiss_get(t, lookups + i);
+        bug_on_always(!val || *val != lookups[i] * 3);
+    }
+    result(name, "lookup hit", n, bench_ns() - start);
+
+    start = bench_ns();
+    for (u32 i = 0; i < n; ++i)
+        bug_on_always(swiss_get(t, misses + i));
+    result(name, "lookup miss", n, bench_ns() - start);
+
+    start = bench_ns();
+    for (u32 i = 0; i < n; ++i)
+        bug_on_always(!swiss_del(t, keys + i));
+    result(name, "erase", n, bench_ns() - start);
+    bug_on_always(swiss_count(t));
+    swiss_destroy(t);
+}
+
+/* check replace, reuse of deleted slots and iteration, with 12 bytes keys.
+ */
+static void check(void)
+{
+    swiss_t *t = swiss_create(12, sizeof(u32), 0, NULL, NULL);
+    u32 key[3] = { 0, 1, 2 }, *val, *k, n;
+    u64 pos;
+
+    for (u32 round = 0; round < 4; ++round) {
+        for (key[0] = 0; key[0] < 10000; ++key[0])
+            *(u32 *)swiss_put(t, key, NULL) = key[0] + round;
+        for (key[0] = 0; key[0] < 10000; key[0] += 2)
+            bug_on_always(!swiss_del(t, key));
+    }
+    bug_on_always(swiss_count(t) != 5000);
+    for (pos = 0, n = 0; (val = swiss_next(t, &pos, (void **)&k)); ++n)
+        bug_on_always(!(k[0] & 1) || k[1] != 1 || k[2] != 2 || *val != k[0] + 3);
+    bug_on_always(n != 5000);
+    swiss_destroy(t);
+    printf("check: group=%d: ok\n", SWISS_GROUP);
+}
+
+int main(int ac, char **av)
+{
+    u32 n = 1000000;
+    u64 rnd = 0x9E3779B97F4A7C15ULL, *keys, *lookups, *misses;
+    int opt;
+
+    while ((opt = getopt(ac, av, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                n = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n keys]\n", *av);
+                exit(1);
+        }
+    }
+    check();
+    keys = malloc(n * sizeof(*keys));
+    lookups = malloc(n * sizeof(*lookups));
+    misses = malloc(n * sizeof(*misses));
+    /* odd keys are inserted, even keys are misses */
+    for (u32 i = 0; i < n; ++i) {
+        keys[i] = bench_rand(&rnd) | 1;
+        misses[i] = bench_rand(&rnd) & ~1UL;
+        lookups[i] = keys[i];
+    }
+    /* look up keys in random order */
+    for (u32 i = n - 1; i > 0; --i) {
+        u32 j = bench_rand(&rnd) % (i + 1);
+        swap(lookups[i], lookups[j]);
+    }
+    bench_hashtable(keys, lookups, misses, n);
+    bench_swiss(keys, lookups, misses, n, false);
+    bench_swiss(keys, lookups, misses, n, true);
+    free(keys);
+    free(lookups);
+    free(misses);
+    exit(0);
+}
@@ -0,0 +1,196 @@
+/* ulist-bench.c - unrolled lists vs list_head traversal benchmark.
+ *
+ * Copyright (C) 2024 Bruno Raoult ("br")
+ * Licensed under the GNU General Public License v3.0 or later.
+ * Some rights reserved. See COPYING.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/gpl-3.0-standalone.html>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later <https://spdx.org/licenses/GPL-3.0-or-later.html>
+ *
+ * Usage: ulist-bench [-n maxelts] [-w walk]
+ *
+ * check:     add/delete elements in an unrolled list, and verify contents,
+ *            also with elements whose size is not a multiple of 8.
+ * traversal: for 1K, 10K, ... up to @maxelts elements, sum u64 values by
+ *            walking:
+ *            - list:     a list_head list, nodes malloc'ed in order.
+ *            - shuffled: a list_head list, linked in random order.
+ *            - ulist:    an unrolled list with inline values.
+ *            - ulist-p:  an unrolled list of pointers to malloc'ed values.
+ *            Each list is walked until about @walk elements are visited.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "brlib.h"
+#include "bug.h"
+#include "list.h"
+#include "ulist.h"
+#include "bench.h"
+
+struct elt {
+    struct list_head list;
+    u64 val;
+};
+
+static void check(void)
+{
+    struct ulist_head head;
+    struct ulist_iter iter;
+    u64 *pos, n = 0, i;
+
+    ulist_init(&head, sizeof(u64));
+    for (i = 0; i < 1000; ++i)
+        ulist_add_tail(&head, &i);
+    for (i = 1; i <= 100; ++i) {
+        u64 val = -i;
+        ulist_add(&head, &val);
+    }
+    bug_on_always(head.count != 1100);
+    /* delete negative and odd values */
+    ulist_for_each(pos, &iter, &head)
+        if ((s64) *pos < 0 || *pos & 1)
+            ulist_del(&iter);
+    bug_on_always(head.count != 500);
+    ulist_for_each(pos, &iter, &head) {
+        bug_on_always(*pos != n);
+        n += 2;
+    }
+    ulist_for_each(pos, &iter, &head)
+        ulist_del(&iter);
+    bug_on_always(!ulist_empty(&head) || !list_empty(&head.nodes));
+    ulist_free(&head);
+
+    /* 12 bytes elements: only 12 bytes are copied, stride is 16 */
+    ulist_init(&head, 12);
+    for (u32 j = 0; j < 100; ++j) {
+        u32 elt[3] = { j, ~j, j * 3 };
+
+        if (j & 1)
+            bug_on_always(!ulist_add_tail(&head, elt));
+        else
+            bug_on_always(!ulist_add(&head, elt));
+    }
+    ulist_for_each(pos, &iter, &head) {
+        u32 *elt = (u32 *)pos;
+
+        bug_on_always((uintptr_t)elt % 8 || elt[1] != ~elt[0] ||
+                      elt[2] != elt[0] * 3);
+    }
+    bug_on_always(head.count != 100);
+    ulist_free(&head);
+    printf("check: ok\n");
+}
+
+static void result(char *name, u64 nelts, u64 visited, s64 elapsed, u64 sum)
+{
+    printf("%-9s elts=%-9lu time=%8.3fms  %6.2f ns/elt  (sum=%lu)\n", name,
+           nelts, elapsed / 1e6, (double) elapsed / visited, sum);
+}
+
+static void bench_list(u64 nelts, u64 walk, bool shuffle)
+{
+    struct elt **elts = malloc(nelts * sizeof(*elts)), *cur;
+    u64 rnd = 0x9E3779B97F4A7C15ULL, sum = 0, loops = max(walk / nelts, 1UL);
+    LIST_HEAD(head);
+    s64 start;
+
+    for (u64 i = 0; i < nelts; ++i) {
+        elts[i] = malloc(sizeof(struct elt));
+        elts[i]->val = i;
+    }
+    if (shuffle) {
+        for (u64 i = nelts - 1; i > 0; --i) {
+            u64 j = bench_rand(&rnd) % (i + 1);
+            swap(elts[i], elts[j]);
+        }
+    }
+    for (u64 i = 0; i < nelts; ++i)
+        list_add_tail(&elts[i]->list, &head);
+
+    start = bench_ns();
+    for (u64 l = 0; l < loops; ++l)
+        list_for_each_entry(cur, &head, list)
+            sum += cur->val;
+    result(shuffle? "shuffled": "list", nelts, loops * nelts, bench_ns() - start, sum);
+
+    for (u64 i = 0; i < nelts; ++i)
+        free(elts[i]);
+    free(elts);
+}
+
+static void bench_ulist(u64 nelts, u64 walk)
+{
+    u64 sum = 0, *pos, loops = max(walk / nelts, 1UL);
+    struct ulist_head head;
+    struct ulist_iter iter;
+    s64 start;
+
+    ulist_init(&head, sizeof(u64));
+    for (u64 i = 0; i < nelts; ++i)
+        ulist_add_tail(&head, &i);
+
+    start = bench_ns();
+    for (u64 l = 0; l < loops; ++l)
+        ulist_for_each(pos, &iter, &head)
+            sum += *pos;
+    result("ulist", nelts, loops * nelts, bench_ns() - start, sum);
+    ulist_free(&head);
+}
+
+static void bench_ulist_ptr(u64 nelts, u64 walk)
+{
+    u64 sum = 0, **pos, loops = max(walk / nelts, 1UL);
+    struct ulist_head head;
+    struct ulist_iter iter;
+    s64 start;
+
+    ulist_init(&head, sizeof(u64 *));
+    for (u64 i = 0; i < nelts; ++i) {
+        u64 *val = malloc(sizeof(*val));
+        *val = i;
+        ulist_add_tail(&head, &val);
+    }
+
+    start = bench_ns();
+    for (u64 l = 0; l < loops; ++l)
+        ulist_for_each(pos, &iter, &head)
+            sum += **pos;
+    result("ulist-p", nelts, loops * nelts, bench_ns() - start, sum);
+
+    ulist_for_each(pos, &iter, &head)
+        free(*pos);
+    ulist_free(&head);
+}
+
+int main(int ac, char **av)
+{
+    u64 maxelts = 10000000, walk = 50000000;
+    int opt;
+
+    while ((opt = getopt(ac, av, "n:w:")) != -1) {
+        switch (opt) {
+            case 'n':
+                maxelts = atol(optarg);
+                break;
+            case 'w':
+                walk = atol(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n maxelts] [-w walk]\n", *av);
+                exit(1);
+        }
+    }
+    check();
+    for (u64 nelts = 1000; nelts <= maxelts; nelts *= 10) {
+        bench_list(nelts, walk, false);
+        bench_list(nelts, walk, true);
+        bench_ulist(nelts, walk);
+        bench_ulist_ptr(nelts, walk);
+    }
+    exit(0);
+}